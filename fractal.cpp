@@ -1,151 +1,7558 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
+#include <d3d11.h>
+#include <d3dcompiler.h>
 #include <complex>
 #include <vector>
+#include <deque>
 #include <thread>
+#include <chrono>
 #include <atomic>
 #include <iostream>
 #include <string>
 #include <iomanip>
 #include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <sstream>
+#include <memory>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma comment(lib, "ws2_32.lib") // Winsock, for the render farm
+#else
+#include <cpuid.h>
+#endif
 
-const int WIDTH = 800;
+// MSVC emits AVX intrinsics in any function; GCC/Clang need the target enabled per function
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+const int WIDTH = 800; // Initial window size; frames follow the client area after resizing
 const int HEIGHT = 800;
 const int BASE_ITER = 250; // Base iterations for normal zoom level
 const int MAX_ITER = 10000; // Max iterations to prevent runaway values
+const int MAX_DEEP_ITER = 1000000; // Cap while perturbation renders deep zooms, whose boundaries need far more
+const int TILE_SIZE = 32; // Edge length of the square tiles handed to the render pool
+const int PREVIEW_STEP = 8; // Sample spacing of the coarsest progressive pass; TILE_SIZE must be a multiple
+const int CLICK_PREVIEW_STEP = PREVIEW_STEP / 2; // Finest pass computed ahead for the view a click would zoom to
+const int FRAME_CACHE_SIZE = 8; // Finished frames kept for panning back, zooming out and reset
+const int MIN_SUBDIVISION = 8; // Rectangle edge below which subdivision computes every pixel
+const double ANTIALIAS_THRESHOLD = 1.0; // Continuous-count difference to a neighbour that calls for more samples
+const float DISTANCE_EDGE = 2.0f; // Estimated distance to the set, in pixels, from which distance mode shows the background
+const int DISTANCE_BATCH = 8; // Pixels per distance kernel call; few, so each batch's fills can spare the next
+
+std::atomic<bool> running(true);
+std::atomic<int> currentMaxIter(BASE_ITER);
+std::atomic<bool> useColor(true); // Default to color mode
+std::atomic<bool> useSmoothColoring(false); // Blend between palette entries by fractional iteration
+std::atomic<bool> useDistanceEstimation(false); // Shade by estimated distance to the set instead of iteration count
+std::atomic<bool> needsRecompute(true); // Set via requestRender() by anything that changes the iteration counts
+std::atomic<bool> useProgressive(true); // Show 1/8, 1/4 and 1/2 resolution previews before the full frame
+std::atomic<bool> useSubdivision(false); // Fill rectangles whose border has one iteration count (Mariani-Silver)
+std::atomic<int> antialiasSamples(1); // Samples per pixel where neighbours differ: 1 (off), 4 or 16
+std::atomic<bool> useProfiling(false); // Record per-frame timings and counters for the overlay and 'stats'
+std::atomic<bool> useSpeculation(true); // Compute likely next views while the render thread is idle
+
+// Profiling. A profiled frame records its phase timings, the iterations its kernels ran and how
+// long each pool worker was busy. The cache counters run all the time, at a few increments per
+// frame, and restart when profiling is turned on. Off, profiling costs a flag test per phase.
+struct FrameProfile {
+    bool valid = false;
+    bool recomputed = false;
+    int width = 0, height = 0, maxIter = 0;
+    int passes = 0;              // Progressive passes colored and published
+    double orbitMs = 0.0;        // Reference orbit and series approximation
+    double computeMs = 0.0;      // Kernels, cache copies and fills, outside orbit and coloring
+    double colorMs = 0.0;
+    double totalMs = 0.0;
+    long long iterations = 0;    // Iterations the kernels ran, past any series skip
+    long long allocations = 0;   // Heap allocations by the rendering threads; 0 in the steady state
+    std::vector<double> busyMs;  // Per pool worker
+};
+
+struct CacheCounters {
+    std::atomic<long long> framePixels{ 0 }, reusedPixels{ 0 }; // Pixels looked up in / copied from the frame cache
+    std::atomic<int> paletteLookups{ 0 }, paletteHits{ 0 };
+    std::atomic<int> orbitLookups{ 0 }, orbitHits{ 0 }, orbitExtensions{ 0 };
+    std::atomic<int> resumes{ 0 }; // Frames that continued the last frame's unfinished pixels
+
+    void reset() {
+        framePixels = 0;
+        reusedPixels = 0;
+        paletteLookups = 0;
+        paletteHits = 0;
+        orbitLookups = 0;
+        orbitHits = 0;
+        orbitExtensions = 0;
+        resumes = 0;
+    }
+};
+
+FrameProfile currentProfile; // Only the render thread touches it, while it renders a profiled frame
+std::atomic<long long> frameIterations(0); // Kernel iterations of the current profiled frame
+std::mutex profileMutex;
+FrameProfile lastProfile; // Last finished profiled frame, guarded by profileMutex
+std::atomic<long long> lastBlitMicros(0);
+CacheCounters cacheCounters;
+
+// Heap allocations of the render thread, the pool workers and the headless renderer, which mark
+// themselves as rendering. Other threads, such as the one painting the overlay, are not counted.
+std::atomic<long long> heapAllocations(0);
+thread_local bool renderingThread = false;
+
+inline void countAllocation() {
+    if (renderingThread) {
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void* operator new(size_t size) {
+    countAllocation();
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+inline double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+HWND hwnd = nullptr;
+
+// Allocates on 64-byte cache-line boundaries. Buffer rows are padded to a whole number of lines
+// and tiles are TILE_SIZE * 4 bytes wide, so threads writing neighbouring tiles never share a line.
+template <typename T>
+struct CacheAlignedAllocator {
+    typedef T value_type;
+
+    CacheAlignedAllocator() = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        countAllocation();
+        void* memory = _mm_malloc(count * sizeof(T), 64);
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* memory, size_t) {
+        _mm_free(memory);
+    }
+
+    // Elements a vector grows by without a value are default-initialized, so new pages stay
+    // untouched until the code that fills them writes them (see sizeBuffers)
+    template <typename U>
+    void construct(U* p) {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const CacheAlignedAllocator<T>&, const CacheAlignedAllocator<U>&) { return false; }
+
+template <typename T>
+using AlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+// Scratch memory of one frame. Every thread that renders bump-allocates from its own arena, in
+// cache lines so that threads never share one. beginScratchFrame() starts a frame, and each arena
+// rewinds in O(1) at its thread's first allocation after that, so whatever a frame took must be
+// dead by the time the next one begins. An arena that ran out during a frame is rebuilt as one
+// block the size of everything that frame took, so frames that repeat never reach the heap.
+const size_t SCRATCH_BLOCK_BYTES = 1 << 20;
+
+std::atomic<unsigned> scratchFrame(0);
+
+void beginScratchFrame() {
+    scratchFrame.fetch_add(1, std::memory_order_release);
+}
+
+class ScratchArena {
+public:
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    ~ScratchArena() {
+        release();
+    }
+
+    void* allocate(size_t bytes) {
+        const unsigned frame = scratchFrame.load(std::memory_order_acquire);
+        if (frame != currentFrame) {
+            rewind();
+            currentFrame = frame;
+        }
+        bytes = (bytes + 63) & ~static_cast<size_t>(63);
+        if (blocks.empty() || used + bytes > blocks.back().bytes) {
+            addBlock(std::max(bytes, SCRATCH_BLOCK_BYTES));
+        }
+        void* memory = blocks.back().memory + used;
+        used += bytes;
+        taken += bytes;
+        return memory;
+    }
+
+private:
+    struct Block {
+        char* memory;
+        size_t bytes;
+    };
+
+    void addBlock(size_t bytes) {
+        CacheAlignedAllocator<char> allocator;
+        blocks.push_back({ allocator.allocate(bytes), bytes });
+        used = 0;
+    }
+
+    void rewind() {
+        if (blocks.size() > 1) {
+            release();
+            addBlock(std::max(taken, SCRATCH_BLOCK_BYTES));
+        }
+        used = 0;
+        taken = 0;
+    }
+
+    void release() {
+        CacheAlignedAllocator<char> allocator;
+        for (const Block& block : blocks) {
+            allocator.deallocate(block.memory, block.bytes);
+        }
+        blocks.clear();
+    }
+
+    std::vector<Block> blocks; // Only the last one is allocated from
+    size_t used = 0;           // Bytes taken from the last block
+    size_t taken = 0;          // Bytes taken in this frame, from all blocks
+    unsigned currentFrame = 0;
+};
+
+inline ScratchArena& scratchArena() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+// Hands out memory of the calling thread's arena; it is all released when the arena rewinds
+template <typename T>
+struct ScratchAllocator {
+    typedef T value_type;
+
+    ScratchAllocator() = default;
+    template <typename U>
+    ScratchAllocator(const ScratchAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(scratchArena().allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const ScratchAllocator<T>&, const ScratchAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const ScratchAllocator<T>&, const ScratchAllocator<U>&) { return false; }
+
+template <typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+// Results of the last full computation, kept so palette changes only rerun the color pass.
+// Rows are bufferStride entries apart, bufferWidth rounded up to a multiple of 16.
+AlignedVector<int> iterationBuffer;
+AlignedVector<float> smoothBuffer; // Fractional iteration in [0, 1) for escaped pixels
+int bufferWidth = 0, bufferHeight = 0, bufferStride = 0;
+int bufferMaxIter = BASE_ITER; // Iteration limit the buffers were computed with
+
+// Double-double number: an unevaluated sum hi + lo of two doubles, good for about 106 bits.
+// The arithmetic below uses Dekker splitting so it stays exact without hardware FMA.
+struct DoubleDouble {
+    double hi;
+    double lo;
+};
+
+inline DoubleDouble quickTwoSum(double a, double b) {
+    double s = a + b;
+    return { s, b - (s - a) };
+}
+
+inline DoubleDouble twoSum(double a, double b) {
+    double s = a + b;
+    double bb = s - a;
+    return { s, (a - (s - bb)) + (b - bb) };
+}
+
+inline DoubleDouble twoProd(double a, double b) {
+    const double splitter = 134217729.0; // 2^27 + 1
+    double p = a * b;
+    double ta = splitter * a;
+    double ah = ta - (ta - a);
+    double al = a - ah;
+    double tb = splitter * b;
+    double bh = tb - (tb - b);
+    double bl = b - bh;
+    return { p, ((ah * bh - p) + ah * bl + al * bh) + al * bl };
+}
+
+inline DoubleDouble operator+(DoubleDouble a, DoubleDouble b) {
+    DoubleDouble s = twoSum(a.hi, b.hi);
+    DoubleDouble t = twoSum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = quickTwoSum(s.hi, s.lo);
+    s.lo += t.lo;
+    return quickTwoSum(s.hi, s.lo);
+}
+
+inline DoubleDouble operator-(DoubleDouble a, DoubleDouble b) {
+    return a + DoubleDouble{ -b.hi, -b.lo };
+}
+
+inline DoubleDouble operator*(DoubleDouble a, DoubleDouble b) {
+    DoubleDouble p = twoProd(a.hi, b.hi);
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return quickTwoSum(p.hi, p.lo);
+}
+
+// Double mantissa with a separate 32-bit binary exponent, for view sizes and perturbation
+// deltas that fall below the smallest normal double (about 1e-308) at very deep zoom.
+// The mantissa is kept in [0.5, 1) (or zero) so comparisons only need the exponent first.
+struct FloatExp {
+    double mantissa;
+    int exponent;
+
+    FloatExp(double value = 0.0) {
+        mantissa = std::frexp(value, &exponent);
+    }
+
+    FloatExp(double m, int e) {
+        int shift;
+        mantissa = std::frexp(m, &shift);
+        exponent = (mantissa == 0.0) ? 0 : e + shift;
+    }
+
+    double toDouble() const {
+        return std::ldexp(mantissa, exponent);
+    }
+
+    // log2 of the magnitude, valid at any depth
+    double log2() const {
+        return std::log2(std::fabs(mantissa)) + exponent;
+    }
+
+    std::string toString() const {
+        if (mantissa == 0.0) {
+            return "0";
+        }
+        double decimalExponent = std::floor(log2() * 0.30102999566398120);
+        double digits = std::pow(10.0, log2() * 0.30102999566398120 - decimalExponent);
+        std::ostringstream out;
+        out << (mantissa < 0 ? "-" : "") << std::setprecision(6) << digits << "e" << static_cast<long long>(decimalExponent);
+        return out.str();
+    }
+
+    // Parses a decimal such as "3", "0.25" or "1.5e-400"; the exponent may leave the double range
+    static bool parse(const std::string& text, FloatExp& result) {
+        const size_t e = text.find_first_of("eE");
+        const std::string digits = text.substr(0, e);
+        char* end = nullptr;
+        const double m = std::strtod(digits.c_str(), &end);
+        if (digits.empty() || *end != '\0') {
+            return false;
+        }
+        long exponent = 0;
+        if (e != std::string::npos) {
+            const std::string power = text.substr(e + 1);
+            exponent = std::strtol(power.c_str(), &end, 10);
+            if (power.empty() || *end != '\0') {
+                return false;
+            }
+        }
+
+        // 10^exponent = 2^bits, split into a binary exponent and a factor in [1, 2)
+        const double bits = exponent * 3.32192809488736235;
+        const double whole = std::floor(bits);
+        result = FloatExp(m * std::exp2(bits - whole), static_cast<int>(whole));
+        return true;
+    }
+};
+
+inline FloatExp operator*(FloatExp a, FloatExp b) {
+    return FloatExp(a.mantissa * b.mantissa, a.exponent + b.exponent);
+}
+
+inline FloatExp operator*(FloatExp a, double b) {
+    return FloatExp(a.mantissa * b, a.exponent);
+}
+
+inline FloatExp operator+(FloatExp a, FloatExp b) {
+    if (a.mantissa == 0.0) {
+        return b;
+    }
+    if (b.mantissa == 0.0) {
+        return a;
+    }
+    // Align to the larger exponent; a gap beyond the mantissa width just drops the smaller term
+    if (a.exponent < b.exponent) {
+        std::swap(a, b);
+    }
+    int gap = a.exponent - b.exponent;
+    if (gap > 60) {
+        return a;
+    }
+    return FloatExp(a.mantissa + std::ldexp(b.mantissa, -gap), a.exponent);
+}
+
+inline FloatExp operator-(FloatExp a, FloatExp b) {
+    return a + FloatExp(-b.mantissa, b.exponent);
+}
+
+inline bool operator<(FloatExp a, FloatExp b) {
+    return (a - b).mantissa < 0.0;
+}
+
+const int BIG_LIMBS = 128; // Fractional 32-bit limbs (4096 bits), the deepest supported zoom
+
+// Arbitrary-precision fixed-point number for the deepest zooms: sign and magnitude with a
+// 32-bit integer part (limb[0]) followed by `precision` fractional 32-bit limbs.
+// Limbs past `precision` are unspecified; arithmetic runs at the larger operand precision
+// and reads the shorter operand through limbAt(), which treats missing limbs as zero.
+struct BigFloat {
+    uint32_t limb[BIG_LIMBS + 1];
+    int precision;
+    bool negative;
+
+    explicit BigFloat(double value = 0.0, int precision = BIG_LIMBS) : precision(precision), negative(value < 0) {
+        std::fill(limb, limb + precision + 1, 0u);
+
+        // Peel off 32 bits at a time; scaling by 2^32 and removing the integer part is exact
+        double x = std::fabs(value);
+        for (int k = 0; k <= precision && x != 0.0; ++k) {
+            double whole = std::floor(x);
+            limb[k] = static_cast<uint32_t>(whole);
+            x = (x - whole) * 4294967296.0;
+        }
+    }
+
+    // Exact conversion of a (possibly far subnormal) FloatExp, truncated to `precision`
+    explicit BigFloat(FloatExp value, int precision = BIG_LIMBS) : BigFloat(0.0, precision) {
+        if (value.mantissa == 0.0) {
+            return;
+        }
+
+        // Split the exponent into whole limbs and a remaining shift of 0..31 bits
+        int limbShift = value.exponent >= 0 ? value.exponent / 32 : -((-value.exponent + 31) / 32);
+        BigFloat scaled(std::ldexp(value.mantissa, value.exponent - 32 * limbShift), precision);
+        negative = scaled.negative;
+        for (int k = 0; k <= precision; ++k) {
+            int source = k + limbShift;
+            limb[k] = (source >= 0 && source <= precision) ? scaled.limb[source] : 0u;
+        }
+    }
+
+    uint32_t limbAt(int k) const {
+        return k <= precision ? limb[k] : 0u;
+    }
+
+    BigFloat withPrecision(int newPrecision) const {
+        BigFloat result = *this;
+        for (int k = precision + 1; k <= newPrecision; ++k) {
+            result.limb[k] = 0;
+        }
+        result.precision = newPrecision;
+        return result;
+    }
+
+    double toDouble() const {
+        double result = 0.0;
+        for (int k = precision; k >= 0; --k) {
+            result = result / 4294967296.0 + limb[k];
+        }
+        return negative ? -result : result;
+    }
+
+    DoubleDouble toDoubleDouble() const;
+
+    // Nearest FloatExp, so small differences of deep coordinates keep their value at any depth
+    FloatExp toFloatExp() const {
+        int first = 0;
+        while (first <= precision && limb[first] == 0) {
+            ++first;
+        }
+        if (first > precision) {
+            return FloatExp(0.0);
+        }
+        double result = 0.0;
+        for (int k = std::min(first + 2, precision); k >= first; --k) {
+            result = result / 4294967296.0 + limb[k];
+        }
+        return FloatExp(negative ? -result : result, -32 * first);
+    }
+
+    // Decimal representation with `digits` digits after the point (truncated)
+    std::string toString(int digits) const {
+        std::string result = negative ? "-" : "";
+        result += std::to_string(limb[0]) + ".";
+
+        uint32_t fraction[BIG_LIMBS + 1];
+        std::copy(limb, limb + precision + 1, fraction);
+        for (int d = 0; d < digits; ++d) {
+            uint64_t carry = 0;
+            for (int k = precision; k >= 1; --k) {
+                uint64_t v = static_cast<uint64_t>(fraction[k]) * 10 + carry;
+                fraction[k] = static_cast<uint32_t>(v);
+                carry = v >> 32;
+            }
+            result += static_cast<char>('0' + carry);
+        }
+        return result;
+    }
+
+    // Parses "[-]digits[.digits]", as printed by toString(), truncated to full precision
+    static bool parse(const std::string& text, BigFloat& result) {
+        const size_t start = (!text.empty() && (text[0] == '-' || text[0] == '+')) ? 1 : 0;
+        const size_t point = text.find('.', start);
+        const std::string whole = text.substr(start, point == std::string::npos ? std::string::npos : point - start);
+        const std::string fraction = point == std::string::npos ? "" : text.substr(point + 1);
+        auto isDigits = [](const std::string& s) { return std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; }); };
+        if ((whole.empty() && fraction.empty()) || whole.size() > 9 || !isDigits(whole) || !isDigits(fraction)) {
+            return false;
+        }
+
+        // Horner from the last digit: x = (digit + x) / 10, dividing the limbs by 10 exactly
+        BigFloat value(0.0);
+        for (auto digit = fraction.rbegin(); digit != fraction.rend(); ++digit) {
+            value.limb[0] = static_cast<uint32_t>(*digit - '0');
+            uint64_t remainder = 0;
+            for (int k = 0; k <= value.precision; ++k) {
+                const uint64_t current = (remainder << 32) | value.limb[k];
+                value.limb[k] = static_cast<uint32_t>(current / 10);
+                remainder = current % 10;
+            }
+        }
+        value.limb[0] = whole.empty() ? 0u : static_cast<uint32_t>(std::stoul(whole));
+        value.negative = text[0] == '-' && std::any_of(value.limb, value.limb + value.precision + 1, [](uint32_t l) { return l != 0; });
+        result = value;
+        return true;
+    }
+};
+
+inline int compareMagnitude(const BigFloat& a, const BigFloat& b) {
+    const int p = std::max(a.precision, b.precision);
+    for (int k = 0; k <= p; ++k) {
+        if (a.limbAt(k) != b.limbAt(k)) {
+            return a.limbAt(k) < b.limbAt(k) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+inline bool operator==(const BigFloat& a, const BigFloat& b) {
+    return compareMagnitude(a, b) == 0 && (a.negative == b.negative || a.toDouble() == 0.0);
+}
+
+inline bool operator!=(const BigFloat& a, const BigFloat& b) {
+    return !(a == b);
+}
+
+// |a| + |b| and |a| - |b| (the latter requires |a| >= |b|), sign left to the caller
+inline void addMagnitude(const BigFloat& a, const BigFloat& b, BigFloat& result) {
+    uint64_t carry = 0;
+    for (int k = result.precision; k >= 0; --k) {
+        uint64_t v = static_cast<uint64_t>(a.limbAt(k)) + b.limbAt(k) + carry;
+        result.limb[k] = static_cast<uint32_t>(v);
+        carry = v >> 32;
+    }
+}
+
+inline void subtractMagnitude(const BigFloat& a, const BigFloat& b, BigFloat& result) {
+    int64_t borrow = 0;
+    for (int k = result.precision; k >= 0; --k) {
+        int64_t v = static_cast<int64_t>(a.limbAt(k)) - b.limbAt(k) - borrow;
+        borrow = v < 0 ? 1 : 0;
+        result.limb[k] = static_cast<uint32_t>(v + (borrow << 32));
+    }
+}
+
+inline BigFloat operator+(const BigFloat& a, const BigFloat& b) {
+    BigFloat result(0.0, std::max(a.precision, b.precision));
+    if (a.negative == b.negative) {
+        addMagnitude(a, b, result);
+        result.negative = a.negative;
+    }
+    else if (compareMagnitude(a, b) >= 0) {
+        subtractMagnitude(a, b, result);
+        result.negative = a.negative;
+    }
+    else {
+        subtractMagnitude(b, a, result);
+        result.negative = b.negative;
+    }
+    return result;
+}
+
+inline BigFloat operator-(const BigFloat& a, const BigFloat& b) {
+    BigFloat negated = b;
+    negated.negative = !b.negative;
+    return a + negated;
+}
+
+// Truncated schoolbook product: only columns that can reach the kept limbs are accumulated
+inline BigFloat operator*(const BigFloat& a, const BigFloat& b) {
+    const int p = std::max(a.precision, b.precision);
+    uint64_t column[BIG_LIMBS + 2];
+    std::fill(column, column + p + 2, 0ull);
+
+    for (int i = 0; i <= std::min(p, a.precision); ++i) {
+        if (a.limb[i] == 0) {
+            continue;
+        }
+        const int lastJ = std::min(b.precision, p + 1 - i);
+        for (int j = 0; j <= lastJ; ++j) {
+            uint64_t product = static_cast<uint64_t>(a.limb[i]) * b.limb[j];
+            column[i + j] += static_cast<uint32_t>(product);
+            if (i + j > 0) {
+                column[i + j - 1] += product >> 32;
+            }
+        }
+    }
+
+    for (int k = p + 1; k > 0; --k) {
+        column[k - 1] += column[k] >> 32;
+        column[k] &= 0xFFFFFFFFu;
+    }
+
+    BigFloat result(0.0, p);
+    for (int k = 0; k <= p; ++k) {
+        result.limb[k] = static_cast<uint32_t>(column[k]);
+    }
+    result.negative = a.negative != b.negative;
+    return result;
+}
+
+inline DoubleDouble BigFloat::toDoubleDouble() const {
+    double hi = toDouble();
+    double lo = (*this - BigFloat(hi, precision)).toDouble();
+    return quickTwoSum(hi, lo);
+}
+
+// Escape-time formulas the viewer draws, chosen with the "formula" command. Multibrot sets
+// raise z to a higher power; Julia sets keep c fixed at the Julia constant and vary the start.
+enum FormulaType { FORMULA_MANDELBROT, FORMULA_MULTIBROT3, FORMULA_MULTIBROT4, FORMULA_MULTIBROT5, FORMULA_JULIA, FORMULA_BURNING_SHIP, FORMULA_TRICORN, FORMULA_COUNT };
+const char* const formulaNames[FORMULA_COUNT] = { "mandelbrot", "multibrot3", "multibrot4", "multibrot5", "julia", "burningship", "tricorn" };
+const int formulaPowers[FORMULA_COUNT] = { 2, 3, 4, 5, 2, 2, 2 };
+// Sets that are connected, so every region of equal iteration count is simply connected and a
+// rectangle with one count all along its border holds no other inside. Subdivision relies on
+// it. The Burning Ship and the tricorn have islands off their main body, and a Julia set is only
+// connected for some constants.
+const bool formulaConnected[FORMULA_COUNT] = { true, true, true, true, false, false, false };
+const double initialJuliaX = -0.8, initialJuliaY = 0.156;
+
+// The view is stored as an exact center plus a size, since at deep zoom the corner
+// coordinates are no longer representable in any hardware floating-point type.
+// Written by the UI and input threads, read by the render thread, all under viewMutex.
+// Panning moves the view by whole pixels away from the center, which stays put as an anchor,
+// so a panned frame computes exactly the same c for every pixel it shares with the last one.
+std::mutex viewMutex;
+BigFloat centerX(-0.5), centerY(0.0);
+long long panX = 0, panY = 0; // Pixels the view has been panned from the center
+FloatExp viewWidth(3.0), viewHeight(3.0);
+int frameWidth = WIDTH, frameHeight = HEIGHT; // Client area size in pixels
+int currentFormula = FORMULA_MANDELBROT;
+double juliaX = initialJuliaX, juliaY = initialJuliaY; // Julia constant c
+
+// Views left by zooming in, so zooming out returns to exactly the same (cached) frames
+struct ViewState {
+    BigFloat centerX, centerY;
+    long long panX, panY;
+    FloatExp viewWidth, viewHeight;
+    int maxIter;
+};
+std::vector<ViewState> zoomHistory; // Guarded by viewMutex
+
+// One view of a zoom path
+struct PathPoint {
+    BigFloat x, y;
+    FloatExp width;
+};
+
+// Zoom path loaded for replay, and the step on screen (counting from 1; 0 before the first)
+std::vector<PathPoint> replayPath; // Guarded by viewMutex
+int replayStep = 0;                // Guarded by viewMutex
+
+const double initialCenterX = -0.5, initialCenterY = 0.0;
+const double initialViewWidth = 3.0, initialViewHeight = 3.0;
+
+// Processor topology as Windows reports it: each physical core with its logical processors (two
+// with SMT) and its efficiency class, which is higher for the faster cores of a hybrid CPU, and
+// each NUMA node with the processors it holds
+struct LogicalProcessor {
+    WORD group;
+    BYTE number;           // Within the processor group
+    BYTE efficiencyClass;
+    int core;              // Physical core, counting from 0
+    int thread;            // Which of the core's logical processors, counting from 0
+    int node;
+};
+
+std::vector<LogicalProcessor> detectProcessors() {
+    std::vector<LogicalProcessor> processors;
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+    std::vector<uint8_t> buffer(length);
+    if (length == 0 || !GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length)) {
+        return processors;
+    }
+
+    std::vector<std::pair<int, GROUP_AFFINITY>> nodes;
+    int cores = 0;
+    for (DWORD offset = 0; offset < length;) {
+        const auto* info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+        if (info->Relationship == RelationProcessorCore) {
+            int thread = 0;
+            for (WORD g = 0; g < info->Processor.GroupCount; ++g) {
+                const GROUP_AFFINITY& mask = info->Processor.GroupMask[g];
+                for (int bit = 0; bit < static_cast<int>(8 * sizeof(KAFFINITY)); ++bit) {
+                    if ((mask.Mask >> bit) & 1) {
+                        processors.push_back({ mask.Group, static_cast<BYTE>(bit), info->Processor.EfficiencyClass, cores, thread++, 0 });
+                    }
+                }
+            }
+            ++cores;
+        }
+        else if (info->Relationship == RelationNumaNode) {
+            nodes.emplace_back(static_cast<int>(info->NumaNode.NodeNumber), info->NumaNode.GroupMask);
+        }
+        offset += info->Size;
+    }
+    for (LogicalProcessor& processor : processors) {
+        for (const auto& node : nodes) {
+            if (node.second.Group == processor.group && ((node.second.Mask >> processor.number) & 1)) {
+                processor.node = node.first;
+            }
+        }
+    }
+    return processors;
+}
+
+// How a pool places its workers: left to the scheduler, pinned one per physical core, or pinned
+// one per logical processor
+enum AffinityPolicy { AFFINITY_NONE, AFFINITY_CORES, AFFINITY_THREADS, AFFINITY_COUNT };
+const char* const affinityNames[AFFINITY_COUNT] = { "none", "cores", "threads" };
+
+// Shares of a job, relative to a worker that has a core of the top efficiency class to itself.
+// Stealing evens out whatever the estimates miss.
+const double EFFICIENT_CORE_WEIGHT = 0.55; // A core of a lower efficiency class (hybrid E-core)
+const double SMT_THREAD_WEIGHT = 0.6;      // Each of two workers sharing one core
+
+// Where one worker runs, and its share of each job
+struct WorkerPlacement {
+    bool pinned;
+    GROUP_AFFINITY affinity;
+    int node;
+    bool efficientCore; // Below the top efficiency class
+    double weight;
+};
+
+// Places `count` workers under the policy, or as many as it has processors for with count 0.
+// Fewer workers than processors take the first threads of the fastest cores first. Workers are
+// ordered by node and core, since each gets a contiguous run of every job.
+std::vector<WorkerPlacement> placeWorkers(int count, int policy) {
+    const std::vector<LogicalProcessor> processors = policy == AFFINITY_NONE ? std::vector<LogicalProcessor>() : detectProcessors();
+    if (processors.empty()) {
+        const int workers = count > 0 ? count : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        return std::vector<WorkerPlacement>(workers, WorkerPlacement{ false, GROUP_AFFINITY(), 0, false, 1.0 });
+    }
+
+    BYTE topClass = 0;
+    std::vector<const LogicalProcessor*> chosen;
+    for (const LogicalProcessor& processor : processors) {
+        topClass = std::max(topClass, processor.efficiencyClass);
+        if (policy == AFFINITY_THREADS || processor.thread == 0) {
+            chosen.push_back(&processor);
+        }
+    }
+    std::stable_sort(chosen.begin(), chosen.end(), [](const LogicalProcessor* a, const LogicalProcessor* b) {
+        return a->thread != b->thread ? a->thread < b->thread : a->efficiencyClass > b->efficiencyClass;
+        });
+    if (count > 0 && count < static_cast<int>(chosen.size())) {
+        chosen.resize(count);
+    }
+    std::sort(chosen.begin(), chosen.end(), [](const LogicalProcessor* a, const LogicalProcessor* b) {
+        return a->node != b->node ? a->node < b->node : a->core != b->core ? a->core < b->core : a->thread < b->thread;
+        });
+
+    std::vector<WorkerPlacement> placements;
+    for (const LogicalProcessor* processor : chosen) {
+        const bool efficientCore = processor->efficiencyClass < topClass;
+        WorkerPlacement placement = { true, GROUP_AFFINITY(), processor->node, efficientCore, efficientCore ? EFFICIENT_CORE_WEIGHT : 1.0 };
+        placement.affinity.Group = processor->group;
+        for (const LogicalProcessor& sibling : processors) {
+            if (sibling.core == processor->core && sibling.group == processor->group && (policy == AFFINITY_CORES || &sibling == processor)) {
+                placement.affinity.Mask |= static_cast<KAFFINITY>(1) << sibling.number;
+            }
+        }
+        const auto sharing = std::count_if(chosen.begin(), chosen.end(), [&](const LogicalProcessor* other) { return other->core == processor->core; });
+        if (sharing > 1) {
+            placement.weight *= SMT_THREAD_WEIGHT;
+        }
+        placements.push_back(placement);
+    }
+    return placements;
+}
+
+// Long-lived pool of render workers, created once in main() and reused by every frame.
+// Each worker owns a queue of task indices; a worker that runs out of its own work steals
+// from the back of another worker's queue, so all cores stay busy until the last tile.
+// Workers are pinned and weighted by placeWorkers(): each job is split in proportion to the
+// weights, and a thief tries the workers of its own NUMA node before the others.
+class RenderPool {
+public:
+    explicit RenderPool(int numWorkers = 0, int policy = AFFINITY_THREADS) {
+        start(numWorkers, policy);
+    }
+
+    ~RenderPool() {
+        stop();
+    }
+
+    // Replaces the workers, once the job in progress (if any) is done. Only for the thread that
+    // runs the frames, between them: exiting workers free their scratch arenas, and with them
+    // whatever a frame in progress keeps there.
+    void configure(int numWorkers, int policy) {
+        std::lock_guard<std::mutex> jobLock(jobMutex);
+        stop();
+        start(numWorkers, policy);
+    }
+
+    int workerCount() const {
+        return static_cast<int>(workers.size());
+    }
+
+    int affinityPolicy() const {
+        return policy;
+    }
+
+    // One line on the workers and where they run
+    std::string describe() const {
+        std::ostringstream text;
+        text << workerCount() << (workerCount() == 1 ? " worker" : " workers");
+        if (queues[0].placement.pinned) {
+            int nodes = 0, efficient = 0;
+            for (const WorkQueue& queue : queues) {
+                nodes = std::max(nodes, queue.placement.node + 1);
+                efficient += queue.placement.efficientCore;
+            }
+            text << " pinned to " << (policy == AFFINITY_CORES ? "cores" : "logical processors") << " on " << nodes << " NUMA node" << (nodes == 1 ? "" : "s");
+            if (efficient > 0) {
+                text << ", " << efficient << " of them on efficient cores";
+            }
+        }
+        else {
+            text << ", not pinned";
+        }
+        return text.str();
+    }
+
+    // Thread priority the workers run the following jobs at
+    void setPriority(int priority) {
+        workerPriority.store(priority);
+    }
+
+    // Milliseconds each worker spent on tasks while profiling was on, since the last call
+    std::vector<double> takeBusyTimes() {
+        std::lock_guard<std::mutex> jobLock(jobMutex);
+        std::vector<double> busy;
+        for (WorkQueue& queue : queues) {
+            busy.push_back(queue.busyNanos.exchange(0) * 1e-6);
+        }
+        return busy;
+    }
+
+    // Runs task(index) for every index in [0, count) on the pool and blocks until all are done.
+    template <typename Task>
+    void parallelFor(int count, Task&& task) {
+        using TaskType = typename std::remove_reference<Task>::type;
+        runJob(count, [](void* context, int index) { (*static_cast<TaskType*>(context))(index); }, &task);
+    }
+
+private:
+    typedef void (*TaskFn)(void*, int);
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::vector<int> items;
+        size_t head = 0; // Owner pops from the front, thieves take from the back
+        std::atomic<long long> busyNanos{ 0 }; // Written by the owner, taken by takeBusyTimes()
+        WorkerPlacement placement;
+        double shareEnd = 0.0; // Fraction of every job that ends with this worker's run
+    };
+
+    // Called with no job running
+    void start(int numWorkers, int affinity) {
+        const std::vector<WorkerPlacement> placements = placeWorkers(numWorkers, affinity);
+        policy = placements[0].pinned ? affinity : AFFINITY_NONE;
+        stopping = false;
+        queues = std::vector<WorkQueue>(placements.size());
+        double total = 0.0;
+        for (const WorkerPlacement& placement : placements) {
+            total += placement.weight;
+        }
+        double share = 0.0;
+        for (size_t i = 0; i < placements.size(); ++i) {
+            share += placements[i].weight;
+            queues[i].placement = placements[i];
+            queues[i].shareEnd = i + 1 == placements.size() ? 1.0 : share / total;
+        }
+        for (size_t i = 0; i < placements.size(); ++i) {
+            workers.emplace_back(&RenderPool::workerLoop, this, static_cast<int>(i), generation);
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+        workers.clear();
+    }
+
+    void runJob(int count, TaskFn fn, void* context) {
+        if (count <= 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> jobLock(jobMutex); // One frame at a time
+
+        // Publish the task before any index becomes visible, so whoever pops an index runs this job
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            jobFn = fn;
+            jobContext = context;
+            remaining = count;
+        }
+
+        // Hand every worker a contiguous run of indices, in proportion to its weight, so
+        // neighbouring tiles share a core and the tiles of a NUMA node's workers are adjacent
+        const int numWorkers = workerCount();
+        int first = 0;
+        for (int w = 0; w < numWorkers; ++w) {
+            WorkQueue& queue = queues[w];
+            const int end = w + 1 == numWorkers ? count : static_cast<int>(count * queue.shareEnd + 0.5);
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.items.clear();
+            queue.head = 0;
+            for (int i = first; i < end; ++i) {
+                queue.items.push_back(i);
+            }
+            first = std::max(first, end);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            ++generation;
+        }
+        wakeWorkers.notify_all();
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        jobDone.wait(lock, [this] { return remaining == 0; });
+    }
+
+    bool popLocal(int worker, int& index) {
+        WorkQueue& queue = queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.head == queue.items.size()) {
+            return false;
+        }
+        index = queue.items[queue.head++];
+        return true;
+    }
+
+    // Takes from the workers of the thief's own node first, then from the others
+    bool steal(int thief, int& index) {
+        const int numWorkers = workerCount();
+        const int node = queues[thief].placement.node;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int offset = 1; offset < numWorkers; ++offset) {
+                WorkQueue& queue = queues[(thief + offset) % numWorkers];
+                if ((queue.placement.node == node) != (pass == 0)) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.head < queue.items.size()) {
+                    index = queue.items.back();
+                    queue.items.pop_back();
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // seenGeneration is the generation when the worker was started, so it waits for the next job
+    void workerLoop(int worker, unsigned long long seenGeneration) {
+        renderingThread = true;
+        const WorkerPlacement& placement = queues[worker].placement;
+        if (placement.pinned) {
+            SetThreadGroupAffinity(GetCurrentThread(), &placement.affinity, nullptr);
+        }
+        // Reserved once pinned, so the queue is allocated on the worker's own node
+        queues[worker].items.reserve(WIDTH * HEIGHT / (TILE_SIZE * TILE_SIZE) + 1);
+
+        int priority = THREAD_PRIORITY_NORMAL;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) {
+                    return;
+                }
+                seenGeneration = generation;
+            }
+            if (workerPriority.load() != priority) {
+                priority = workerPriority.load();
+                SetThreadPriority(GetCurrentThread(), priority);
+            }
+
+            int index;
+            int completed = 0;
+            const bool timed = useProfiling.load(std::memory_order_relaxed);
+            const auto start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            while (popLocal(worker, index) || steal(worker, index)) {
+                jobFn(jobContext, index);
+                ++completed;
+            }
+            if (timed) {
+                queues[worker].busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            if (completed > 0) {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                remaining -= completed;
+                if (remaining == 0) {
+                    jobDone.notify_all();
+                }
+            }
+        }
+    }
+
+    std::vector<WorkQueue> queues;
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::mutex stateMutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable jobDone;
+    TaskFn jobFn = nullptr;
+    void* jobContext = nullptr;
+    int remaining = 0;
+    unsigned long long generation = 0;
+    bool stopping = false;
+    int policy = AFFINITY_NONE;
+    std::atomic<int> workerPriority{ THREAD_PRIORITY_NORMAL };
+};
+
+RenderPool* renderPool = nullptr; // Owned by main()
+
+// Where a point's orbit stopped, so that raising the iteration limit can continue it instead of
+// starting over. Perturbation kernels keep the delta from the reference orbit in zr, zi.
+struct OrbitState {
+    double zr, zi;
+    double zrLo, ziLo; // Low words of z at double-double precision
+    int reference;     // Reference orbit index, for perturbation
+    bool settled;      // Proven never to escape (cardioid, bulb or cycle), so nothing to continue
+};
+
+// Escape-time kernels: each computes the iteration counts for `count` points c = (cx[i], cy[i]),
+// plus |z|^2 at escape for the points that escape, from which smooth coloring is derived.
+// With startIter 0 every point starts at z = 0; otherwise all of them continue at iteration
+// startIter from the z in states[i]. Either way states[i] receives where each point stopped.
+typedef void (*EscapeKernel)(const double* cx, const double* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states);
+
+enum KernelType { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512, KERNEL_COUNT };
+const char* const kernelNames[KERNEL_COUNT] = { "scalar", "avx2", "avx512" };
+
+std::atomic<int> selectedKernel(KERNEL_SCALAR); // Replaced by the best supported kernel in main()
+
+// Closed-form test for the main cardioid and the period-2 bulb, which hold most interior
+// pixels at shallow zoom. Those points never escape, so they get maxIter without iterating.
+inline bool isInsideCardioidOrBulb(double x, double y) {
+    double xq = x - 0.25;
+    double q = xq * xq + y * y;
+    if (q * (q + xq) <= 0.25 * y * y) {
+        return true;
+    }
+    double xb = x + 1.0;
+    return xb * xb + y * y <= 0.0625;
+}
+
+// Interior points that fail the closed-form test usually settle into an attracting cycle.
+// Brent-style periodicity checking saves z at iterations 1, 2, 4, 8, ... and compares every
+// later z against it. Only an exact repeat counts, because only then is the orbit provably a
+// cycle that never escapes, which keeps the output identical to running all maxIter iterations.
+// A resumed orbit saves its starting z and continues with the next power of two.
+inline int firstCheckpoint(int startIter) {
+    int checkpoint = 1;
+    while (checkpoint <= startIter) {
+        checkpoint *= 2;
+    }
+    return checkpoint;
+}
+
+// Portable scalar fallback, kept identical to the original std::complex iteration
+void escapeScalar(const double* cx, const double* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    for (int i = 0; i < count; ++i) {
+        states[i].settled = isInsideCardioidOrBulb(cx[i], cy[i]);
+        if (states[i].settled) {
+            iterations[i] = maxIter;
+            continue;
+        }
+
+        std::complex<long double> c(cx[i], cy[i]);
+        std::complex<long double> z(0, 0);
+        if (startIter > 0) {
+            z = std::complex<long double>(states[i].zr, states[i].zi);
+        }
+        std::complex<long double> saved = z;
+        int checkpoint = firstCheckpoint(startIter);
+        int n = startIter;
+
+        while (std::abs(z) <= 2.0 && n < maxIter) {
+            z = z * z + c;
+            ++n;
+
+            if (z == saved) {
+                n = maxIter;
+                states[i].settled = true;
+                break;
+            }
+            if (n == checkpoint) {
+                saved = z;
+                checkpoint *= 2;
+            }
+        }
+
+        iterations[i] = n;
+        magnitudes[i] = static_cast<float>(std::norm(z));
+        states[i].zr = static_cast<double>(z.real());
+        states[i].zi = static_cast<double>(z.imag());
+    }
+}
+
+// Iterates 4 points at once in AVX2 doubles. Lanes that escape are masked out of the count and
+// the loop ends once every lane has escaped or reached maxIter.
+TARGET_AVX2 void escapeAVX2(const double* cx, const double* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    const __m256d four = _mm256_set1_pd(4.0);
+
+    for (int i = 0; i < count; i += 4) {
+        // Pad a short final group by repeating its last point; the extra lanes are discarded
+        alignas(32) double laneX[4], laneY[4], laneZr[4], laneZi[4];
+        alignas(32) long long laneInside[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = cx[src];
+            laneY[lane] = cy[src];
+            laneZr[lane] = startIter > 0 ? states[src].zr : 0.0;
+            laneZi[lane] = startIter > 0 ? states[src].zi : 0.0;
+            laneInside[lane] = isInsideCardioidOrBulb(cx[src], cy[src]) ? -1 : 0;
+        }
+
+        const __m256d cr = _mm256_load_pd(laneX);
+        const __m256d ci = _mm256_load_pd(laneY);
+        __m256d zr = _mm256_load_pd(laneZr);
+        __m256d zi = _mm256_load_pd(laneZi);
+        __m256d savedR = zr, savedI = zi;
+        __m256d escapedMag = _mm256_setzero_pd();
+        int checkpoint = firstCheckpoint(startIter);
+        __m256i counts = _mm256_set1_epi64x(startIter);
+
+        // Lanes known to be interior drop out at once and receive maxIter at the end
+        __m256d interior = _mm256_load_pd(reinterpret_cast<const double*>(laneInside));
+        __m256d active = _mm256_andnot_pd(interior, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+
+        for (int n = startIter; n < maxIter; ++n) {
+            __m256d zr2 = _mm256_mul_pd(zr, zr);
+            __m256d zi2 = _mm256_mul_pd(zi, zi);
+
+            // |z|^2 <= 4 replaces the sqrt in std::abs; escaped lanes stay masked off
+            __m256d mag = _mm256_add_pd(zr2, zi2);
+            __m256d inside = _mm256_cmp_pd(mag, four, _CMP_LE_OQ);
+            escapedMag = _mm256_blendv_pd(escapedMag, mag, _mm256_andnot_pd(inside, active));
+            active = _mm256_and_pd(active, inside);
+            if (_mm256_movemask_pd(active) == 0) {
+                break;
+            }
+
+            // An active lane is all ones (-1), so subtracting it counts one iteration
+            counts = _mm256_sub_epi64(counts, _mm256_castpd_si256(active));
+
+            __m256d zrzi = _mm256_mul_pd(zr, zi);
+            zi = _mm256_add_pd(_mm256_add_pd(zrzi, zrzi), ci);
+            zr = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), cr);
+
+            __m256d repeat = _mm256_and_pd(active, _mm256_and_pd(_mm256_cmp_pd(zr, savedR, _CMP_EQ_OQ), _mm256_cmp_pd(zi, savedI, _CMP_EQ_OQ)));
+            interior = _mm256_or_pd(interior, repeat);
+            active = _mm256_andnot_pd(repeat, active);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(counts), _mm256_castsi256_pd(_mm256_set1_epi64x(maxIter)), interior));
+
+        alignas(32) long long laneCounts[4];
+        alignas(32) double laneMag[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneCounts), counts);
+        _mm256_store_pd(laneMag, escapedMag);
+        _mm256_store_pd(laneZr, zr);
+        _mm256_store_pd(laneZi, zi);
+        const int settled = _mm256_movemask_pd(interior);
+        for (int lane = 0; lane < 4 && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            magnitudes[i + lane] = static_cast<float>(laneMag[lane]);
+            states[i + lane].zr = laneZr[lane];
+            states[i + lane].zi = laneZi[lane];
+            states[i + lane].settled = (settled >> lane) & 1;
+        }
+    }
+}
+
+// Same as escapeAVX2 with 8 lanes, using AVX-512 mask registers for lane retirement
+TARGET_AVX512 void escapeAVX512(const double* cx, const double* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    const __m512d four = _mm512_set1_pd(4.0);
+    const __m512i one = _mm512_set1_epi64(1);
+
+    for (int i = 0; i < count; i += 8) {
+        alignas(64) double laneX[8], laneY[8], laneZr[8], laneZi[8];
+        __mmask8 interior = 0;
+        for (int lane = 0; lane < 8; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = cx[src];
+            laneY[lane] = cy[src];
+            laneZr[lane] = startIter > 0 ? states[src].zr : 0.0;
+            laneZi[lane] = startIter > 0 ? states[src].zi : 0.0;
+            if (isInsideCardioidOrBulb(cx[src], cy[src])) {
+                interior |= static_cast<__mmask8>(1u << lane);
+            }
+        }
+
+        const __m512d cr = _mm512_load_pd(laneX);
+        const __m512d ci = _mm512_load_pd(laneY);
+        __m512d zr = _mm512_load_pd(laneZr);
+        __m512d zi = _mm512_load_pd(laneZi);
+        __m512d savedR = zr, savedI = zi;
+        __m512d escapedMag = _mm512_setzero_pd();
+        int checkpoint = firstCheckpoint(startIter);
+        __m512i counts = _mm512_set1_epi64(startIter);
+        __mmask8 active = static_cast<__mmask8>(~interior);
+
+        for (int n = startIter; n < maxIter; ++n) {
+            __m512d zr2 = _mm512_mul_pd(zr, zr);
+            __m512d zi2 = _mm512_mul_pd(zi, zi);
+
+            __m512d mag = _mm512_add_pd(zr2, zi2);
+            __mmask8 inside = _mm512_cmp_pd_mask(mag, four, _CMP_LE_OQ);
+            escapedMag = _mm512_mask_mov_pd(escapedMag, static_cast<__mmask8>(active & ~inside), mag);
+            active = static_cast<__mmask8>(active & inside);
+            if (active == 0) {
+                break;
+            }
+
+            counts = _mm512_mask_add_epi64(counts, active, counts, one);
+
+            __m512d zrzi = _mm512_mul_pd(zr, zi);
+            zi = _mm512_add_pd(_mm512_add_pd(zrzi, zrzi), ci);
+            zr = _mm512_add_pd(_mm512_sub_pd(zr2, zi2), cr);
+
+            __mmask8 repeat = _mm512_mask_cmp_pd_mask(_mm512_mask_cmp_pd_mask(active, zr, savedR, _CMP_EQ_OQ), zi, savedI, _CMP_EQ_OQ);
+            interior |= repeat;
+            active = static_cast<__mmask8>(active & ~repeat);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = _mm512_mask_mov_epi64(counts, interior, _mm512_set1_epi64(maxIter));
+
+        alignas(64) long long laneCounts[8];
+        alignas(64) double laneMag[8];
+        _mm512_store_si512(laneCounts, counts);
+        _mm512_store_pd(laneMag, escapedMag);
+        _mm512_store_pd(laneZr, zr);
+        _mm512_store_pd(laneZi, zi);
+        for (int lane = 0; lane < 8 && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            magnitudes[i + lane] = static_cast<float>(laneMag[lane]);
+            states[i + lane].zr = laneZr[lane];
+            states[i + lane].zi = laneZi[lane];
+            states[i + lane].settled = (interior >> lane) & 1;
+        }
+    }
+}
+
+// Single-precision kernels for wide views, where float already resolves the pixel spacing
+void escapeFloatScalar(const double* cx, const double* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    for (int i = 0; i < count; ++i) {
+        states[i].settled = isInsideCardioidOrBulb(cx[i], cy[i]);
+        if (states[i].settled) {
+            iterations[i] = maxIter;
+            continue;
+        }
+
+        const float cr = static_cast<float>(cx[i]);
+        const float ci = static_cast<float>(cy[i]);
+        float zr = startIter > 0 ? static_cast<float>(states[i].zr) : 0.0f;
+        float zi = startIter > 0 ? static_cast<float>(states[i].zi) : 0.0f;
+        float savedR = zr, savedI = zi;
+        int checkpoint = firstCheckpoint(startIter);
+        int n = startIter;
+
+        while (n < maxIter) {
+            float zr2 = zr * zr;
+            float zi2 = zi * zi;
+            if (zr2 + zi2 > 4.0f) {
+                magnitudes[i] = zr2 + zi2;
+                break;
+            }
+            zi = 2.0f * zr * zi + ci;
+            zr = zr2 - zi2 + cr;
+            ++n;
+
+            if (zr == savedR && zi == savedI) {
+                n = maxIter;
+                states[i].settled = true;
+                break;
+            }
+            if (n == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        iterations[i] = n;
+        states[i].zr = zr;
+        states[i].zi = zi;
+    }
+}
+
+TARGET_AVX2 void escapeFloatAVX2(const double* cx, const double* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    const __m256 four = _mm256_set1_ps(4.0f);
+
+    for (int i = 0; i < count; i += 8) {
+        alignas(32) float laneX[8], laneY[8], laneZr[8], laneZi[8];
+        alignas(32) int laneInside[8];
+        for (int lane = 0; lane < 8; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = static_cast<float>(cx[src]);
+            laneY[lane] = static_cast<float>(cy[src]);
+            laneZr[lane] = startIter > 0 ? static_cast<float>(states[src].zr) : 0.0f;
+            laneZi[lane] = startIter > 0 ? static_cast<float>(states[src].zi) : 0.0f;
+            laneInside[lane] = isInsideCardioidOrBulb(cx[src], cy[src]) ? -1 : 0;
+        }
+
+        const __m256 cr = _mm256_load_ps(laneX);
+        const __m256 ci = _mm256_load_ps(laneY);
+        __m256 zr = _mm256_load_ps(laneZr);
+        __m256 zi = _mm256_load_ps(laneZi);
+        __m256 savedR = zr, savedI = zi;
+        __m256 escapedMag = _mm256_setzero_ps();
+        int checkpoint = firstCheckpoint(startIter);
+        __m256i counts = _mm256_set1_epi32(startIter);
+        __m256 interior = _mm256_load_ps(reinterpret_cast<const float*>(laneInside));
+        __m256 active = _mm256_andnot_ps(interior, _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+
+        for (int n = startIter; n < maxIter; ++n) {
+            __m256 zr2 = _mm256_mul_ps(zr, zr);
+            __m256 zi2 = _mm256_mul_ps(zi, zi);
+
+            __m256 mag = _mm256_add_ps(zr2, zi2);
+            __m256 inside = _mm256_cmp_ps(mag, four, _CMP_LE_OQ);
+            escapedMag = _mm256_blendv_ps(escapedMag, mag, _mm256_andnot_ps(inside, active));
+            active = _mm256_and_ps(active, inside);
+            if (_mm256_movemask_ps(active) == 0) {
+                break;
+            }
+
+            counts = _mm256_sub_epi32(counts, _mm256_castps_si256(active));
+
+            __m256 zrzi = _mm256_mul_ps(zr, zi);
+            zi = _mm256_add_ps(_mm256_add_ps(zrzi, zrzi), ci);
+            zr = _mm256_add_ps(_mm256_sub_ps(zr2, zi2), cr);
+
+            __m256 repeat = _mm256_and_ps(active, _mm256_and_ps(_mm256_cmp_ps(zr, savedR, _CMP_EQ_OQ), _mm256_cmp_ps(zi, savedI, _CMP_EQ_OQ)));
+            interior = _mm256_or_ps(interior, repeat);
+            active = _mm256_andnot_ps(repeat, active);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(counts), _mm256_castsi256_ps(_mm256_set1_epi32(maxIter)), interior));
+
+        alignas(32) int laneCounts[8];
+        alignas(32) float laneMag[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneCounts), counts);
+        _mm256_store_ps(laneMag, escapedMag);
+        _mm256_store_ps(laneZr, zr);
+        _mm256_store_ps(laneZi, zi);
+        const int settled = _mm256_movemask_ps(interior);
+        for (int lane = 0; lane < 8 && i + lane < count; ++lane) {
+            iterations[i + lane] = laneCounts[lane];
+            magnitudes[i + lane] = laneMag[lane];
+            states[i + lane].zr = laneZr[lane];
+            states[i + lane].zi = laneZi[lane];
+            states[i + lane].settled = (settled >> lane) & 1;
+        }
+    }
+}
+
+TARGET_AVX512 void escapeFloatAVX512(const double* cx, const double* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    const __m512 four = _mm512_set1_ps(4.0f);
+    const __m512i one = _mm512_set1_epi32(1);
+
+    for (int i = 0; i < count; i += 16) {
+        alignas(64) float laneX[16], laneY[16], laneZr[16], laneZi[16];
+        __mmask16 interior = 0;
+        for (int lane = 0; lane < 16; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = static_cast<float>(cx[src]);
+            laneY[lane] = static_cast<float>(cy[src]);
+            laneZr[lane] = startIter > 0 ? static_cast<float>(states[src].zr) : 0.0f;
+            laneZi[lane] = startIter > 0 ? static_cast<float>(states[src].zi) : 0.0f;
+            if (isInsideCardioidOrBulb(cx[src], cy[src])) {
+                interior |= static_cast<__mmask16>(1u << lane);
+            }
+        }
+
+        const __m512 cr = _mm512_load_ps(laneX);
+        const __m512 ci = _mm512_load_ps(laneY);
+        __m512 zr = _mm512_load_ps(laneZr);
+        __m512 zi = _mm512_load_ps(laneZi);
+        __m512 savedR = zr, savedI = zi;
+        __m512 escapedMag = _mm512_setzero_ps();
+        int checkpoint = firstCheckpoint(startIter);
+        __m512i counts = _mm512_set1_epi32(startIter);
+        __mmask16 active = static_cast<__mmask16>(~interior);
+
+        for (int n = startIter; n < maxIter; ++n) {
+            __m512 zr2 = _mm512_mul_ps(zr, zr);
+            __m512 zi2 = _mm512_mul_ps(zi, zi);
+
+            __m512 mag = _mm512_add_ps(zr2, zi2);
+            __mmask16 inside = _mm512_cmp_ps_mask(mag, four, _CMP_LE_OQ);
+            escapedMag = _mm512_mask_mov_ps(escapedMag, static_cast<__mmask16>(active & ~inside), mag);
+            active = static_cast<__mmask16>(active & inside);
+            if (active == 0) {
+                break;
+            }
+
+            counts = _mm512_mask_add_epi32(counts, active, counts, one);
+
+            __m512 zrzi = _mm512_mul_ps(zr, zi);
+            zi = _mm512_add_ps(_mm512_add_ps(zrzi, zrzi), ci);
+            zr = _mm512_add_ps(_mm512_sub_ps(zr2, zi2), cr);
+
+            __mmask16 repeat = _mm512_mask_cmp_ps_mask(_mm512_mask_cmp_ps_mask(active, zr, savedR, _CMP_EQ_OQ), zi, savedI, _CMP_EQ_OQ);
+            interior |= repeat;
+            active = static_cast<__mmask16>(active & ~repeat);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = _mm512_mask_mov_epi32(counts, interior, _mm512_set1_epi32(maxIter));
+
+        alignas(64) int laneCounts[16];
+        alignas(64) float laneMag[16];
+        _mm512_store_si512(laneCounts, counts);
+        _mm512_store_ps(laneMag, escapedMag);
+        _mm512_store_ps(laneZr, zr);
+        _mm512_store_ps(laneZi, zi);
+        for (int lane = 0; lane < 16 && i + lane < count; ++lane) {
+            iterations[i + lane] = laneCounts[lane];
+            magnitudes[i + lane] = laneMag[lane];
+            states[i + lane].zr = laneZr[lane];
+            states[i + lane].zi = laneZi[lane];
+            states[i + lane].settled = (interior >> lane) & 1;
+        }
+    }
+}
+
+// Double-double kernels for zooms past double precision
+typedef void (*EscapeKernelDD)(const DoubleDouble* cx, const DoubleDouble* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states);
+
+void escapeDoubleDoubleScalar(const DoubleDouble* cx, const DoubleDouble* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    for (int i = 0; i < count; ++i) {
+        states[i].settled = isInsideCardioidOrBulb(cx[i].hi, cy[i].hi);
+        if (states[i].settled) {
+            iterations[i] = maxIter;
+            continue;
+        }
+
+        DoubleDouble zr = { 0.0, 0.0 };
+        DoubleDouble zi = { 0.0, 0.0 };
+        if (startIter > 0) {
+            zr = { states[i].zr, states[i].zrLo };
+            zi = { states[i].zi, states[i].ziLo };
+        }
+        DoubleDouble savedR = zr, savedI = zi;
+        int checkpoint = firstCheckpoint(startIter);
+        int n = startIter;
+
+        while (n < maxIter) {
+            DoubleDouble zr2 = zr * zr;
+            DoubleDouble zi2 = zi * zi;
+            if (zr2.hi + zi2.hi > 4.0) {
+                magnitudes[i] = static_cast<float>(zr2.hi + zi2.hi);
+                break;
+            }
+            DoubleDouble zrzi = zr * zi;
+            zi = zrzi + zrzi + cy[i];
+            zr = zr2 - zi2 + cx[i];
+            ++n;
+
+            if (zr.hi == savedR.hi && zr.lo == savedR.lo && zi.hi == savedI.hi && zi.lo == savedI.lo) {
+                n = maxIter;
+                states[i].settled = true;
+                break;
+            }
+            if (n == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        iterations[i] = n;
+        states[i].zr = zr.hi;
+        states[i].zrLo = zr.lo;
+        states[i].zi = zi.hi;
+        states[i].ziLo = zi.lo;
+    }
+}
+
+// 4-lane double-double arithmetic; FMA gives the exact product error term directly
+struct DoubleDouble4 {
+    __m256d hi;
+    __m256d lo;
+};
+
+TARGET_AVX2 inline DoubleDouble4 quickTwoSum4(__m256d a, __m256d b) {
+    __m256d s = _mm256_add_pd(a, b);
+    return { s, _mm256_sub_pd(b, _mm256_sub_pd(s, a)) };
+}
+
+TARGET_AVX2 inline DoubleDouble4 twoSum4(__m256d a, __m256d b) {
+    __m256d s = _mm256_add_pd(a, b);
+    __m256d bb = _mm256_sub_pd(s, a);
+    return { s, _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(s, bb)), _mm256_sub_pd(b, bb)) };
+}
+
+TARGET_AVX2 inline DoubleDouble4 add4(DoubleDouble4 a, DoubleDouble4 b) {
+    DoubleDouble4 s = twoSum4(a.hi, b.hi);
+    DoubleDouble4 t = twoSum4(a.lo, b.lo);
+    s = quickTwoSum4(s.hi, _mm256_add_pd(s.lo, t.hi));
+    return quickTwoSum4(s.hi, _mm256_add_pd(s.lo, t.lo));
+}
+
+TARGET_AVX2 inline DoubleDouble4 mul4(DoubleDouble4 a, DoubleDouble4 b) {
+    __m256d p = _mm256_mul_pd(a.hi, b.hi);
+    __m256d e = _mm256_fmsub_pd(a.hi, b.hi, p);
+    e = _mm256_fmadd_pd(a.hi, b.lo, e);
+    e = _mm256_fmadd_pd(a.lo, b.hi, e);
+    return quickTwoSum4(p, e);
+}
+
+TARGET_AVX2 void escapeDoubleDoubleAVX2(const DoubleDouble* cx, const DoubleDouble* cy, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    const __m256d four = _mm256_set1_pd(4.0);
+
+    for (int i = 0; i < count; i += 4) {
+        alignas(32) double xHi[4], xLo[4], yHi[4], yLo[4];
+        alignas(32) double zrHi[4], zrLo[4], ziHi[4], ziLo[4];
+        alignas(32) long long laneInside[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            xHi[lane] = cx[src].hi;
+            xLo[lane] = cx[src].lo;
+            yHi[lane] = cy[src].hi;
+            yLo[lane] = cy[src].lo;
+            zrHi[lane] = startIter > 0 ? states[src].zr : 0.0;
+            zrLo[lane] = startIter > 0 ? states[src].zrLo : 0.0;
+            ziHi[lane] = startIter > 0 ? states[src].zi : 0.0;
+            ziLo[lane] = startIter > 0 ? states[src].ziLo : 0.0;
+            laneInside[lane] = isInsideCardioidOrBulb(cx[src].hi, cy[src].hi) ? -1 : 0;
+        }
+
+        const DoubleDouble4 cr = { _mm256_load_pd(xHi), _mm256_load_pd(xLo) };
+        const DoubleDouble4 ci = { _mm256_load_pd(yHi), _mm256_load_pd(yLo) };
+        DoubleDouble4 zr = { _mm256_load_pd(zrHi), _mm256_load_pd(zrLo) };
+        DoubleDouble4 zi = { _mm256_load_pd(ziHi), _mm256_load_pd(ziLo) };
+        DoubleDouble4 savedR = zr, savedI = zi;
+        __m256d escapedMag = _mm256_setzero_pd();
+        int checkpoint = firstCheckpoint(startIter);
+        __m256i counts = _mm256_set1_epi64x(startIter);
+        __m256d interior = _mm256_load_pd(reinterpret_cast<const double*>(laneInside));
+        __m256d active = _mm256_andnot_pd(interior, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+
+        for (int n = startIter; n < maxIter; ++n) {
+            DoubleDouble4 zr2 = mul4(zr, zr);
+            DoubleDouble4 zi2 = mul4(zi, zi);
+
+            __m256d mag = _mm256_add_pd(zr2.hi, zi2.hi);
+            __m256d inside = _mm256_cmp_pd(mag, four, _CMP_LE_OQ);
+            escapedMag = _mm256_blendv_pd(escapedMag, mag, _mm256_andnot_pd(inside, active));
+            active = _mm256_and_pd(active, inside);
+            if (_mm256_movemask_pd(active) == 0) {
+                break;
+            }
+
+            counts = _mm256_sub_epi64(counts, _mm256_castpd_si256(active));
+
+            DoubleDouble4 zrzi = mul4(zr, zi);
+            zi = add4(add4(zrzi, zrzi), ci);
+            DoubleDouble4 negZi2 = { _mm256_sub_pd(_mm256_setzero_pd(), zi2.hi), _mm256_sub_pd(_mm256_setzero_pd(), zi2.lo) };
+            zr = add4(add4(zr2, negZi2), cr);
+
+            __m256d sameR = _mm256_and_pd(_mm256_cmp_pd(zr.hi, savedR.hi, _CMP_EQ_OQ), _mm256_cmp_pd(zr.lo, savedR.lo, _CMP_EQ_OQ));
+            __m256d sameI = _mm256_and_pd(_mm256_cmp_pd(zi.hi, savedI.hi, _CMP_EQ_OQ), _mm256_cmp_pd(zi.lo, savedI.lo, _CMP_EQ_OQ));
+            __m256d repeat = _mm256_and_pd(active, _mm256_and_pd(sameR, sameI));
+            interior = _mm256_or_pd(interior, repeat);
+            active = _mm256_andnot_pd(repeat, active);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(counts), _mm256_castsi256_pd(_mm256_set1_epi64x(maxIter)), interior));
+
+        alignas(32) long long laneCounts[4];
+        alignas(32) double laneMag[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneCounts), counts);
+        _mm256_store_pd(laneMag, escapedMag);
+        _mm256_store_pd(zrHi, zr.hi);
+        _mm256_store_pd(zrLo, zr.lo);
+        _mm256_store_pd(ziHi, zi.hi);
+        _mm256_store_pd(ziLo, zi.lo);
+        const int settled = _mm256_movemask_pd(interior);
+        for (int lane = 0; lane < 4 && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            magnitudes[i + lane] = static_cast<float>(laneMag[lane]);
+            states[i + lane].zr = zrHi[lane];
+            states[i + lane].zrLo = zrLo[lane];
+            states[i + lane].zi = ziHi[lane];
+            states[i + lane].ziLo = ziLo[lane];
+            states[i + lane].settled = (settled >> lane) & 1;
+        }
+    }
+}
+
+// Arbitrary-precision fallback for zooms beyond double-double; one point at a time
+int escapeBigFloat(const BigFloat& cx, const BigFloat& cy, int maxIter, float& magnitude) {
+    if (isInsideCardioidOrBulb(cx.toDouble(), cy.toDouble())) {
+        return maxIter;
+    }
+
+    BigFloat zr(0.0, cx.precision);
+    BigFloat zi(0.0, cx.precision);
+    BigFloat savedR = zr, savedI = zi;
+    int checkpoint = 1;
+    int n = 0;
+
+    while (n < maxIter) {
+        BigFloat zr2 = zr * zr;
+        BigFloat zi2 = zi * zi;
+        if (zr2.toDouble() + zi2.toDouble() > 4.0) {
+            magnitude = static_cast<float>(zr2.toDouble() + zi2.toDouble());
+            break;
+        }
+        BigFloat zrzi = zr * zi;
+        zi = zrzi + zrzi + cy;
+        zr = zr2 - zi2 + cx;
+        ++n;
+
+        if (zr == savedR && zi == savedI) {
+            n = maxIter;
+            break;
+        }
+        if (n == checkpoint) {
+            savedR = zr;
+            savedI = zi;
+            checkpoint *= 2;
+        }
+    }
+
+    return n;
+}
+
+const EscapeKernel kernelTable[KERNEL_COUNT] = { escapeScalar, escapeAVX2, escapeAVX512 };
+const EscapeKernel floatKernelTable[KERNEL_COUNT] = { escapeFloatScalar, escapeFloatAVX2, escapeFloatAVX512 };
+const EscapeKernelDD doubleDoubleKernelTable[KERNEL_COUNT] = { escapeDoubleDoubleScalar, escapeDoubleDoubleAVX2, escapeDoubleDoubleAVX2 };
+
+// Kernels for the other formulas. Each iterates z -> w^Power + c, where w is z itself, z with
+// the absolute value of both parts (Burning Ship) or the conjugate of z (Tricorn); Julia sets
+// start z at the pixel and take the Julia constant (kx, ky) as c. Variant and Power are template
+// parameters, so every formula compiles to its own straight-line step with no branches on the
+// formula inside the loop. Only the Mandelbrot set has the closed-form interior test; the others
+// rely on periodicity checking alone.
+enum FormulaVariant { VARIANT_MANDELBROT, VARIANT_JULIA, VARIANT_BURNING_SHIP, VARIANT_TRICORN };
+
+typedef void (*FormulaKernel)(const double* cx, const double* cy, double kx, double ky, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states);
+typedef void (*FormulaKernelDD)(const DoubleDouble* cx, const DoubleDouble* cy, DoubleDouble kx, DoubleDouble ky, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states);
+typedef int (*FormulaKernelBig)(const BigFloat& cx, const BigFloat& cy, const BigFloat& kx, const BigFloat& ky, int maxIter, float& magnitude);
+
+// The rest of the arithmetic formulaStep needs, for each scalar type it iterates in
+inline float absolute(float x) {
+    return std::abs(x);
+}
+
+inline double absolute(double x) {
+    return std::abs(x);
+}
+
+inline DoubleDouble absolute(DoubleDouble x) {
+    return x.hi < 0.0 ? DoubleDouble{ -x.hi, -x.lo } : x;
+}
+
+inline BigFloat absolute(const BigFloat& x) {
+    BigFloat result = x;
+    result.negative = false;
+    return result;
+}
+
+inline DoubleDouble operator-(DoubleDouble x) {
+    return { -x.hi, -x.lo };
+}
+
+inline BigFloat operator-(const BigFloat& x) {
+    BigFloat result = x;
+    result.negative = !x.negative;
+    return result;
+}
+
+inline bool operator==(DoubleDouble a, DoubleDouble b) {
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+inline double leadingDouble(float x) {
+    return x;
+}
+
+inline double leadingDouble(double x) {
+    return x;
+}
+
+inline double leadingDouble(DoubleDouble x) {
+    return x.hi;
+}
+
+inline double leadingDouble(const BigFloat& x) {
+    return x.toDouble();
+}
+
+// Orbit state in the scalar type of a kernel, for resuming
+inline void loadOrbit(const OrbitState& state, float& zr, float& zi) {
+    zr = static_cast<float>(state.zr);
+    zi = static_cast<float>(state.zi);
+}
+
+inline void loadOrbit(const OrbitState& state, double& zr, double& zi) {
+    zr = state.zr;
+    zi = state.zi;
+}
+
+inline void loadOrbit(const OrbitState& state, DoubleDouble& zr, DoubleDouble& zi) {
+    zr = { state.zr, state.zrLo };
+    zi = { state.zi, state.ziLo };
+}
+
+inline void storeOrbit(OrbitState& state, double zr, double zi) {
+    state.zr = zr;
+    state.zi = zi;
+}
+
+inline void storeOrbit(OrbitState& state, DoubleDouble zr, DoubleDouble zi) {
+    state.zr = zr.hi;
+    state.zrLo = zr.lo;
+    state.zi = zi.hi;
+    state.ziLo = zi.lo;
+}
+
+// One step z -> w^Power + c on any scalar type. w^Power is one squaring followed by Power - 2
+// multiplications, a loop the compiler unrolls since Power is a constant.
+template <int Variant, int Power, typename Real>
+inline void formulaStep(Real& zr, Real& zi, const Real& cr, const Real& ci) {
+    const Real wr = Variant == VARIANT_BURNING_SHIP ? absolute(zr) : zr;
+    const Real wi = Variant == VARIANT_BURNING_SHIP ? absolute(zi) : Variant == VARIANT_TRICORN ? -zi : zi;
+    const Real wrwi = wr * wi;
+    Real pr = wr * wr - wi * wi;
+    Real pi = wrwi + wrwi;
+    for (int k = 2; k < Power; ++k) {
+        const Real next = pr * wr - pi * wi;
+        pi = pr * wi + pi * wr;
+        pr = next;
+    }
+    zr = pr + cr;
+    zi = pi + ci;
+}
+
+// Scalar formula kernel for float, double and double-double, iterating in Real on coordinates
+// given as Coordinate
+template <typename Real, typename Coordinate, int Variant, int Power>
+void escapeFormulaScalar(const Coordinate* cx, const Coordinate* cy, Coordinate kx, Coordinate ky, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    for (int i = 0; i < count; ++i) {
+        const Real px = static_cast<Real>(cx[i]);
+        const Real py = static_cast<Real>(cy[i]);
+        const Real cr = Variant == VARIANT_JULIA ? static_cast<Real>(kx) : px;
+        const Real ci = Variant == VARIANT_JULIA ? static_cast<Real>(ky) : py;
+        Real zr = Variant == VARIANT_JULIA ? px : Real();
+        Real zi = Variant == VARIANT_JULIA ? py : Real();
+        if (startIter > 0) {
+            loadOrbit(states[i], zr, zi);
+        }
+        Real savedR = zr, savedI = zi;
+        int checkpoint = firstCheckpoint(startIter);
+        int n = startIter;
+        states[i].settled = false;
+
+        while (n < maxIter) {
+            const double mag = leadingDouble(zr * zr) + leadingDouble(zi * zi);
+            if (mag > 4.0) {
+                magnitudes[i] = static_cast<float>(mag);
+                break;
+            }
+            formulaStep<Variant, Power>(zr, zi, cr, ci);
+            ++n;
+
+            if (zr == savedR && zi == savedI) {
+                n = maxIter;
+                states[i].settled = true;
+                break;
+            }
+            if (n == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        iterations[i] = n;
+        storeOrbit(states[i], zr, zi);
+    }
+}
+
+// Lane operations of the AVX2 formula kernel on 4 doubles or 8 floats. As in escapeAVX2, lane
+// masks are vectors with all bits of a lane set or clear, and counts are integers of lane width.
+template <typename Scalar>
+struct LanesAVX2;
+
+template <>
+struct LanesAVX2<double> {
+    typedef __m256d Value;
+    typedef long long Count;
+    static const int width = 4;
+
+    TARGET_AVX2 static __m256d load(const double* p) { return _mm256_load_pd(p); }
+    TARGET_AVX2 static void store(double* p, __m256d v) { _mm256_store_pd(p, v); }
+    TARGET_AVX2 static __m256d set(double x) { return _mm256_set1_pd(x); }
+    TARGET_AVX2 static __m256d add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+    TARGET_AVX2 static __m256d sub(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+    TARGET_AVX2 static __m256d mul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+    TARGET_AVX2 static __m256d absolute(__m256d a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    TARGET_AVX2 static __m256d negate(__m256d a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+    TARGET_AVX2 static __m256d lessEqual(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    TARGET_AVX2 static __m256d equal(__m256d a, __m256d b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    TARGET_AVX2 static __m256d both(__m256d a, __m256d b) { return _mm256_and_pd(a, b); }
+    TARGET_AVX2 static __m256d either(__m256d a, __m256d b) { return _mm256_or_pd(a, b); }
+    TARGET_AVX2 static __m256d without(__m256d a, __m256d b) { return _mm256_andnot_pd(b, a); }
+    TARGET_AVX2 static __m256d blend(__m256d a, __m256d b, __m256d mask) { return _mm256_blendv_pd(a, b, mask); }
+    TARGET_AVX2 static __m256d allLanes() { return _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); }
+    TARGET_AVX2 static int bits(__m256d mask) { return _mm256_movemask_pd(mask); }
+    TARGET_AVX2 static __m256i counts(int n) { return _mm256_set1_epi64x(n); }
+    TARGET_AVX2 static __m256i countActive(__m256i counts, __m256d active) { return _mm256_sub_epi64(counts, _mm256_castpd_si256(active)); }
+    TARGET_AVX2 static __m256i blendCounts(__m256i a, __m256i b, __m256d mask) {
+        return _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), mask));
+    }
+};
+
+template <>
+struct LanesAVX2<float> {
+    typedef __m256 Value;
+    typedef int Count;
+    static const int width = 8;
+
+    TARGET_AVX2 static __m256 load(const float* p) { return _mm256_load_ps(p); }
+    TARGET_AVX2 static void store(float* p, __m256 v) { _mm256_store_ps(p, v); }
+    TARGET_AVX2 static __m256 set(float x) { return _mm256_set1_ps(x); }
+    TARGET_AVX2 static __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+    TARGET_AVX2 static __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+    TARGET_AVX2 static __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+    TARGET_AVX2 static __m256 absolute(__m256 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    TARGET_AVX2 static __m256 negate(__m256 a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+    TARGET_AVX2 static __m256 lessEqual(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    TARGET_AVX2 static __m256 equal(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    TARGET_AVX2 static __m256 both(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+    TARGET_AVX2 static __m256 either(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+    TARGET_AVX2 static __m256 without(__m256 a, __m256 b) { return _mm256_andnot_ps(b, a); }
+    TARGET_AVX2 static __m256 blend(__m256 a, __m256 b, __m256 mask) { return _mm256_blendv_ps(a, b, mask); }
+    TARGET_AVX2 static __m256 allLanes() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+    TARGET_AVX2 static int bits(__m256 mask) { return _mm256_movemask_ps(mask); }
+    TARGET_AVX2 static __m256i counts(int n) { return _mm256_set1_epi32(n); }
+    TARGET_AVX2 static __m256i countActive(__m256i counts, __m256 active) { return _mm256_sub_epi32(counts, _mm256_castps_si256(active)); }
+    TARGET_AVX2 static __m256i blendCounts(__m256i a, __m256i b, __m256 mask) {
+        return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), mask));
+    }
+};
+
+// Formula kernel on AVX2 lanes, structured like escapeAVX2. The step repeats formulaStep in lane
+// operations, since a generic step could not be inlined into code compiled for AVX2.
+template <typename Scalar, int Variant, int Power>
+TARGET_AVX2 void escapeFormulaAVX2(const double* cx, const double* cy, double kx, double ky, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    typedef LanesAVX2<Scalar> L;
+    typedef typename L::Value Value;
+    const Value four = L::set(4);
+
+    for (int i = 0; i < count; i += L::width) {
+        alignas(32) Scalar laneX[L::width], laneY[L::width], laneZr[L::width], laneZi[L::width];
+        for (int lane = 0; lane < L::width; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = static_cast<Scalar>(cx[src]);
+            laneY[lane] = static_cast<Scalar>(cy[src]);
+            laneZr[lane] = startIter > 0 ? static_cast<Scalar>(states[src].zr) : Variant == VARIANT_JULIA ? laneX[lane] : 0;
+            laneZi[lane] = startIter > 0 ? static_cast<Scalar>(states[src].zi) : Variant == VARIANT_JULIA ? laneY[lane] : 0;
+        }
+
+        const Value cr = Variant == VARIANT_JULIA ? L::set(static_cast<Scalar>(kx)) : L::load(laneX);
+        const Value ci = Variant == VARIANT_JULIA ? L::set(static_cast<Scalar>(ky)) : L::load(laneY);
+        Value zr = L::load(laneZr);
+        Value zi = L::load(laneZi);
+        Value savedR = zr, savedI = zi;
+        Value escapedMag = L::set(0);
+        int checkpoint = firstCheckpoint(startIter);
+        __m256i counts = L::counts(startIter);
+        Value interior = L::set(0);
+        Value active = L::allLanes();
+
+        for (int n = startIter; n < maxIter; ++n) {
+            Value mag = L::add(L::mul(zr, zr), L::mul(zi, zi));
+            Value inside = L::lessEqual(mag, four);
+            escapedMag = L::blend(escapedMag, mag, L::without(active, inside));
+            active = L::both(active, inside);
+            if (L::bits(active) == 0) {
+                break;
+            }
+
+            counts = L::countActive(counts, active);
+
+            const Value wr = Variant == VARIANT_BURNING_SHIP ? L::absolute(zr) : zr;
+            const Value wi = Variant == VARIANT_BURNING_SHIP ? L::absolute(zi) : Variant == VARIANT_TRICORN ? L::negate(zi) : zi;
+            const Value wrwi = L::mul(wr, wi);
+            Value pr = L::sub(L::mul(wr, wr), L::mul(wi, wi));
+            Value pi = L::add(wrwi, wrwi);
+            for (int k = 2; k < Power; ++k) {
+                const Value next = L::sub(L::mul(pr, wr), L::mul(pi, wi));
+                pi = L::add(L::mul(pr, wi), L::mul(pi, wr));
+                pr = next;
+            }
+            zr = L::add(pr, cr);
+            zi = L::add(pi, ci);
+
+            Value repeat = L::both(active, L::both(L::equal(zr, savedR), L::equal(zi, savedI)));
+            interior = L::either(interior, repeat);
+            active = L::without(active, repeat);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = L::blendCounts(counts, L::counts(maxIter), interior);
+
+        alignas(32) typename L::Count laneCounts[L::width];
+        alignas(32) Scalar laneMag[L::width];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneCounts), counts);
+        L::store(laneMag, escapedMag);
+        L::store(laneZr, zr);
+        L::store(laneZi, zi);
+        const int settled = L::bits(interior);
+        for (int lane = 0; lane < L::width && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            magnitudes[i + lane] = static_cast<float>(laneMag[lane]);
+            states[i + lane].zr = laneZr[lane];
+            states[i + lane].zi = laneZi[lane];
+            states[i + lane].settled = (settled >> lane) & 1;
+        }
+    }
+}
+
+// Lane operations of the AVX-512 formula kernel for 8 doubles or 16 floats, with mask registers
+template <typename Scalar>
+struct LanesAVX512;
+
+template <>
+struct LanesAVX512<double> {
+    typedef __m512d Value;
+    typedef long long Count;
+    typedef __mmask8 Mask;
+    static const int width = 8;
+
+    TARGET_AVX512 static __m512d load(const double* p) { return _mm512_load_pd(p); }
+    TARGET_AVX512 static void store(double* p, __m512d v) { _mm512_store_pd(p, v); }
+    TARGET_AVX512 static __m512d set(double x) { return _mm512_set1_pd(x); }
+    TARGET_AVX512 static __m512d add(__m512d a, __m512d b) { return _mm512_add_pd(a, b); }
+    TARGET_AVX512 static __m512d sub(__m512d a, __m512d b) { return _mm512_sub_pd(a, b); }
+    TARGET_AVX512 static __m512d mul(__m512d a, __m512d b) { return _mm512_mul_pd(a, b); }
+    TARGET_AVX512 static __m512d absolute(__m512d a) { return _mm512_abs_pd(a); }
+    TARGET_AVX512 static __m512d negate(__m512d a) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a), _mm512_castpd_si512(_mm512_set1_pd(-0.0))));
+    }
+    TARGET_AVX512 static Mask lessEqual(__m512d a, __m512d b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+    TARGET_AVX512 static Mask equal(Mask mask, __m512d a, __m512d b) { return _mm512_mask_cmp_pd_mask(mask, a, b, _CMP_EQ_OQ); }
+    TARGET_AVX512 static __m512d move(__m512d a, Mask mask, __m512d b) { return _mm512_mask_mov_pd(a, mask, b); }
+    TARGET_AVX512 static __m512i counts(int n) { return _mm512_set1_epi64(n); }
+    TARGET_AVX512 static __m512i countActive(__m512i counts, Mask active) { return _mm512_mask_add_epi64(counts, active, counts, _mm512_set1_epi64(1)); }
+    TARGET_AVX512 static __m512i moveCounts(__m512i a, Mask mask, __m512i b) { return _mm512_mask_mov_epi64(a, mask, b); }
+};
+
+template <>
+struct LanesAVX512<float> {
+    typedef __m512 Value;
+    typedef int Count;
+    typedef __mmask16 Mask;
+    static const int width = 16;
+
+    TARGET_AVX512 static __m512 load(const float* p) { return _mm512_load_ps(p); }
+    TARGET_AVX512 static void store(float* p, __m512 v) { _mm512_store_ps(p, v); }
+    TARGET_AVX512 static __m512 set(float x) { return _mm512_set1_ps(x); }
+    TARGET_AVX512 static __m512 add(__m512 a, __m512 b) { return _mm512_add_ps(a, b); }
+    TARGET_AVX512 static __m512 sub(__m512 a, __m512 b) { return _mm512_sub_ps(a, b); }
+    TARGET_AVX512 static __m512 mul(__m512 a, __m512 b) { return _mm512_mul_ps(a, b); }
+    TARGET_AVX512 static __m512 absolute(__m512 a) { return _mm512_abs_ps(a); }
+    TARGET_AVX512 static __m512 negate(__m512 a) {
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(_mm512_set1_ps(-0.0f))));
+    }
+    TARGET_AVX512 static Mask lessEqual(__m512 a, __m512 b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    TARGET_AVX512 static Mask equal(Mask mask, __m512 a, __m512 b) { return _mm512_mask_cmp_ps_mask(mask, a, b, _CMP_EQ_OQ); }
+    TARGET_AVX512 static __m512 move(__m512 a, Mask mask, __m512 b) { return _mm512_mask_mov_ps(a, mask, b); }
+    TARGET_AVX512 static __m512i counts(int n) { return _mm512_set1_epi32(n); }
+    TARGET_AVX512 static __m512i countActive(__m512i counts, Mask active) { return _mm512_mask_add_epi32(counts, active, counts, _mm512_set1_epi32(1)); }
+    TARGET_AVX512 static __m512i moveCounts(__m512i a, Mask mask, __m512i b) { return _mm512_mask_mov_epi32(a, mask, b); }
+};
+
+// Same as escapeFormulaAVX2 on AVX-512 lanes, structured like escapeAVX512
+template <typename Scalar, int Variant, int Power>
+TARGET_AVX512 void escapeFormulaAVX512(const double* cx, const double* cy, double kx, double ky, int count, int startIter, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    typedef LanesAVX512<Scalar> L;
+    typedef typename L::Value Value;
+    typedef typename L::Mask Mask;
+    const Value four = L::set(4);
+
+    for (int i = 0; i < count; i += L::width) {
+        alignas(64) Scalar laneX[L::width], laneY[L::width], laneZr[L::width], laneZi[L::width];
+        for (int lane = 0; lane < L::width; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = static_cast<Scalar>(cx[src]);
+            laneY[lane] = static_cast<Scalar>(cy[src]);
+            laneZr[lane] = startIter > 0 ? static_cast<Scalar>(states[src].zr) : Variant == VARIANT_JULIA ? laneX[lane] : 0;
+            laneZi[lane] = startIter > 0 ? static_cast<Scalar>(states[src].zi) : Variant == VARIANT_JULIA ? laneY[lane] : 0;
+        }
+
+        const Value cr = Variant == VARIANT_JULIA ? L::set(static_cast<Scalar>(kx)) : L::load(laneX);
+        const Value ci = Variant == VARIANT_JULIA ? L::set(static_cast<Scalar>(ky)) : L::load(laneY);
+        Value zr = L::load(laneZr);
+        Value zi = L::load(laneZi);
+        Value savedR = zr, savedI = zi;
+        Value escapedMag = L::set(0);
+        int checkpoint = firstCheckpoint(startIter);
+        __m512i counts = L::counts(startIter);
+        Mask interior = 0;
+        Mask active = static_cast<Mask>(~interior);
+
+        for (int n = startIter; n < maxIter; ++n) {
+            Value mag = L::add(L::mul(zr, zr), L::mul(zi, zi));
+            Mask inside = L::lessEqual(mag, four);
+            escapedMag = L::move(escapedMag, static_cast<Mask>(active & ~inside), mag);
+            active = static_cast<Mask>(active & inside);
+            if (active == 0) {
+                break;
+            }
+
+            counts = L::countActive(counts, active);
+
+            const Value wr = Variant == VARIANT_BURNING_SHIP ? L::absolute(zr) : zr;
+            const Value wi = Variant == VARIANT_BURNING_SHIP ? L::absolute(zi) : Variant == VARIANT_TRICORN ? L::negate(zi) : zi;
+            const Value wrwi = L::mul(wr, wi);
+            Value pr = L::sub(L::mul(wr, wr), L::mul(wi, wi));
+            Value pi = L::add(wrwi, wrwi);
+            for (int k = 2; k < Power; ++k) {
+                const Value next = L::sub(L::mul(pr, wr), L::mul(pi, wi));
+                pi = L::add(L::mul(pr, wi), L::mul(pi, wr));
+                pr = next;
+            }
+            zr = L::add(pr, cr);
+            zi = L::add(pi, ci);
+
+            Mask repeat = L::equal(L::equal(active, zr, savedR), zi, savedI);
+            interior |= repeat;
+            active = static_cast<Mask>(active & ~repeat);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = L::moveCounts(counts, interior, L::counts(maxIter));
+
+        alignas(64) typename L::Count laneCounts[L::width];
+        alignas(64) Scalar laneMag[L::width];
+        _mm512_store_si512(laneCounts, counts);
+        L::store(laneMag, escapedMag);
+        L::store(laneZr, zr);
+        L::store(laneZi, zi);
+        for (int lane = 0; lane < L::width && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            magnitudes[i + lane] = static_cast<float>(laneMag[lane]);
+            states[i + lane].zr = laneZr[lane];
+            states[i + lane].zi = laneZi[lane];
+            states[i + lane].settled = (interior >> lane) & 1;
+        }
+    }
+}
+
+// Arbitrary-precision formula fallback, one point at a time like escapeBigFloat
+template <int Variant, int Power>
+int escapeBigFloatFormula(const BigFloat& cx, const BigFloat& cy, const BigFloat& kx, const BigFloat& ky, int maxIter, float& magnitude) {
+    const BigFloat& cr = Variant == VARIANT_JULIA ? kx : cx;
+    const BigFloat& ci = Variant == VARIANT_JULIA ? ky : cy;
+    BigFloat zr = Variant == VARIANT_JULIA ? cx : BigFloat(0.0, cx.precision);
+    BigFloat zi = Variant == VARIANT_JULIA ? cy : BigFloat(0.0, cx.precision);
+    BigFloat savedR = zr, savedI = zi;
+    int checkpoint = 1;
+    int n = 0;
+
+    while (n < maxIter) {
+        const double mag = leadingDouble(zr * zr) + leadingDouble(zi * zi);
+        if (mag > 4.0) {
+            magnitude = static_cast<float>(mag);
+            break;
+        }
+        formulaStep<Variant, Power>(zr, zi, cr, ci);
+        ++n;
+
+        if (zr == savedR && zi == savedI) {
+            n = maxIter;
+            break;
+        }
+        if (n == checkpoint) {
+            savedR = zr;
+            savedI = zi;
+            checkpoint *= 2;
+        }
+    }
+
+    return n;
+}
+
+// Indexed by FormulaType, then KernelType. The Mandelbrot set has the kernels above instead.
+const FormulaKernel formulaKernelTable[FORMULA_COUNT][KERNEL_COUNT] = {
+    { nullptr, nullptr, nullptr },
+    { escapeFormulaScalar<double, double, VARIANT_MANDELBROT, 3>, escapeFormulaAVX2<double, VARIANT_MANDELBROT, 3>, escapeFormulaAVX512<double, VARIANT_MANDELBROT, 3> },
+    { escapeFormulaScalar<double, double, VARIANT_MANDELBROT, 4>, escapeFormulaAVX2<double, VARIANT_MANDELBROT, 4>, escapeFormulaAVX512<double, VARIANT_MANDELBROT, 4> },
+    { escapeFormulaScalar<double, double, VARIANT_MANDELBROT, 5>, escapeFormulaAVX2<double, VARIANT_MANDELBROT, 5>, escapeFormulaAVX512<double, VARIANT_MANDELBROT, 5> },
+    { escapeFormulaScalar<double, double, VARIANT_JULIA, 2>, escapeFormulaAVX2<double, VARIANT_JULIA, 2>, escapeFormulaAVX512<double, VARIANT_JULIA, 2> },
+    { escapeFormulaScalar<double, double, VARIANT_BURNING_SHIP, 2>, escapeFormulaAVX2<double, VARIANT_BURNING_SHIP, 2>, escapeFormulaAVX512<double, VARIANT_BURNING_SHIP, 2> },
+    { escapeFormulaScalar<double, double, VARIANT_TRICORN, 2>, escapeFormulaAVX2<double, VARIANT_TRICORN, 2>, escapeFormulaAVX512<double, VARIANT_TRICORN, 2> },
+};
+const FormulaKernel floatFormulaKernelTable[FORMULA_COUNT][KERNEL_COUNT] = {
+    { nullptr, nullptr, nullptr },
+    { escapeFormulaScalar<float, double, VARIANT_MANDELBROT, 3>, escapeFormulaAVX2<float, VARIANT_MANDELBROT, 3>, escapeFormulaAVX512<float, VARIANT_MANDELBROT, 3> },
+    { escapeFormulaScalar<float, double, VARIANT_MANDELBROT, 4>, escapeFormulaAVX2<float, VARIANT_MANDELBROT, 4>, escapeFormulaAVX512<float, VARIANT_MANDELBROT, 4> },
+    { escapeFormulaScalar<float, double, VARIANT_MANDELBROT, 5>, escapeFormulaAVX2<float, VARIANT_MANDELBROT, 5>, escapeFormulaAVX512<float, VARIANT_MANDELBROT, 5> },
+    { escapeFormulaScalar<float, double, VARIANT_JULIA, 2>, escapeFormulaAVX2<float, VARIANT_JULIA, 2>, escapeFormulaAVX512<float, VARIANT_JULIA, 2> },
+    { escapeFormulaScalar<float, double, VARIANT_BURNING_SHIP, 2>, escapeFormulaAVX2<float, VARIANT_BURNING_SHIP, 2>, escapeFormulaAVX512<float, VARIANT_BURNING_SHIP, 2> },
+    { escapeFormulaScalar<float, double, VARIANT_TRICORN, 2>, escapeFormulaAVX2<float, VARIANT_TRICORN, 2>, escapeFormulaAVX512<float, VARIANT_TRICORN, 2> },
+};
+
+// Double-double and bignum formulas iterate one point at a time at every kernel level
+const FormulaKernelDD doubleDoubleFormulaTable[FORMULA_COUNT] = {
+    nullptr,
+    escapeFormulaScalar<DoubleDouble, DoubleDouble, VARIANT_MANDELBROT, 3>,
+    escapeFormulaScalar<DoubleDouble, DoubleDouble, VARIANT_MANDELBROT, 4>,
+    escapeFormulaScalar<DoubleDouble, DoubleDouble, VARIANT_MANDELBROT, 5>,
+    escapeFormulaScalar<DoubleDouble, DoubleDouble, VARIANT_JULIA, 2>,
+    escapeFormulaScalar<DoubleDouble, DoubleDouble, VARIANT_BURNING_SHIP, 2>,
+    escapeFormulaScalar<DoubleDouble, DoubleDouble, VARIANT_TRICORN, 2>,
+};
+const FormulaKernelBig bigFloatFormulaTable[FORMULA_COUNT] = {
+    nullptr,
+    escapeBigFloatFormula<VARIANT_MANDELBROT, 3>,
+    escapeBigFloatFormula<VARIANT_MANDELBROT, 4>,
+    escapeBigFloatFormula<VARIANT_MANDELBROT, 5>,
+    escapeBigFloatFormula<VARIANT_JULIA, 2>,
+    escapeBigFloatFormula<VARIANT_BURNING_SHIP, 2>,
+    escapeBigFloatFormula<VARIANT_TRICORN, 2>,
+};
+
+// Distance estimation, for the Mandelbrot set. Alongside z the distance kernels carry its
+// derivative dz/dc through dz' = 2 z dz + 1, and iterate on out to DISTANCE_BAILOUT so that
+// the estimate b = 2 |z| ln|z| / |dz| has settled. The true distance from c to the set lies
+// between b / 4 and b, which is what lets distance mode skip pixels safely. Kernels write b in
+// pixels, scaled by pixelsPerUnit, and 0 for points that never escape. The derivative only
+// needs a double, whatever precision z is iterated in.
+const double DISTANCE_BAILOUT = 1e10; // |z|^2 at which the distance kernels stop
+typedef void (*DistanceKernel)(const double* cx, const double* cy, int count, int maxIter, double pixelsPerUnit, int* iterations, float* distances);
+
+// b in pixels from |z|^2 and |dz| at escape; |dz| rather than its square, which overflows
+// at bignum depths
+inline float distanceEstimate(double magnitude, double derivative, double pixelsPerUnit) {
+    const double b = std::sqrt(magnitude) * std::log(magnitude) / derivative * pixelsPerUnit;
+    return static_cast<float>(std::min(b, 1e30));
+}
+
+template <typename Coordinate>
+void estimateDistanceScalar(const Coordinate* cx, const Coordinate* cy, int count, int maxIter, double pixelsPerUnit, int* iterations, float* distances) {
+    for (int i = 0; i < count; ++i) {
+        distances[i] = 0.0f;
+        if (isInsideCardioidOrBulb(leadingDouble(cx[i]), leadingDouble(cy[i]))) {
+            iterations[i] = maxIter;
+            continue;
+        }
+
+        Coordinate zr = Coordinate(), zi = Coordinate();
+        Coordinate savedR = zr, savedI = zi;
+        double dr = 0.0, di = 0.0;
+        int checkpoint = 1;
+        int n = 0;
+
+        while (n < maxIter) {
+            const double zrd = leadingDouble(zr);
+            const double zid = leadingDouble(zi);
+            const double mag = zrd * zrd + zid * zid;
+            if (mag > DISTANCE_BAILOUT) {
+                distances[i] = distanceEstimate(mag, std::hypot(dr, di), pixelsPerUnit);
+                break;
+            }
+            const double tr = zrd * dr - zid * di;
+            const double ti = zrd * di + zid * dr;
+            dr = tr + tr + 1.0;
+            di = ti + ti;
+            formulaStep<VARIANT_MANDELBROT, 2>(zr, zi, cx[i], cy[i]);
+            ++n;
+
+            if (zr == savedR && zi == savedI) {
+                n = maxIter;
+                break;
+            }
+            if (n == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        iterations[i] = n;
+    }
+}
+
+// estimateDistanceScalar<double> in 4 AVX2 lanes, retiring lanes as escapeAVX2 does
+TARGET_AVX2 void estimateDistanceAVX2(const double* cx, const double* cy, int count, int maxIter, double pixelsPerUnit, int* iterations, float* distances) {
+    const __m256d bailout = _mm256_set1_pd(DISTANCE_BAILOUT);
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    for (int i = 0; i < count; i += 4) {
+        alignas(32) double laneX[4], laneY[4];
+        alignas(32) long long laneInside[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = cx[src];
+            laneY[lane] = cy[src];
+            laneInside[lane] = isInsideCardioidOrBulb(cx[src], cy[src]) ? -1 : 0;
+        }
+
+        const __m256d cr = _mm256_load_pd(laneX);
+        const __m256d ci = _mm256_load_pd(laneY);
+        __m256d zr = _mm256_setzero_pd(), zi = _mm256_setzero_pd();
+        __m256d dr = _mm256_setzero_pd(), di = _mm256_setzero_pd();
+        __m256d savedR = zr, savedI = zi;
+        __m256d escapedMag = _mm256_setzero_pd(), escapedDr = _mm256_setzero_pd(), escapedDi = _mm256_setzero_pd();
+        int checkpoint = 1;
+        __m256i counts = _mm256_setzero_si256();
+
+        __m256d interior = _mm256_load_pd(reinterpret_cast<const double*>(laneInside));
+        __m256d active = _mm256_andnot_pd(interior, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)));
+
+        for (int n = 0; n < maxIter; ++n) {
+            __m256d zr2 = _mm256_mul_pd(zr, zr);
+            __m256d zi2 = _mm256_mul_pd(zi, zi);
+            __m256d mag = _mm256_add_pd(zr2, zi2);
+            __m256d inside = _mm256_cmp_pd(mag, bailout, _CMP_LE_OQ);
+            __m256d escaping = _mm256_andnot_pd(inside, active);
+            escapedMag = _mm256_blendv_pd(escapedMag, mag, escaping);
+            escapedDr = _mm256_blendv_pd(escapedDr, dr, escaping);
+            escapedDi = _mm256_blendv_pd(escapedDi, di, escaping);
+            active = _mm256_and_pd(active, inside);
+            if (_mm256_movemask_pd(active) == 0) {
+                break;
+            }
+            counts = _mm256_sub_epi64(counts, _mm256_castpd_si256(active));
+
+            __m256d tr = _mm256_sub_pd(_mm256_mul_pd(zr, dr), _mm256_mul_pd(zi, di));
+            __m256d ti = _mm256_add_pd(_mm256_mul_pd(zr, di), _mm256_mul_pd(zi, dr));
+            dr = _mm256_add_pd(_mm256_add_pd(tr, tr), one);
+            di = _mm256_add_pd(ti, ti);
+
+            __m256d zrzi = _mm256_mul_pd(zr, zi);
+            zi = _mm256_add_pd(_mm256_add_pd(zrzi, zrzi), ci);
+            zr = _mm256_add_pd(_mm256_sub_pd(zr2, zi2), cr);
+
+            __m256d repeat = _mm256_and_pd(active, _mm256_and_pd(_mm256_cmp_pd(zr, savedR, _CMP_EQ_OQ), _mm256_cmp_pd(zi, savedI, _CMP_EQ_OQ)));
+            interior = _mm256_or_pd(interior, repeat);
+            active = _mm256_andnot_pd(repeat, active);
+            if (n + 1 == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+
+        counts = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(counts), _mm256_castsi256_pd(_mm256_set1_epi64x(maxIter)), interior));
+
+        alignas(32) long long laneCounts[4];
+        alignas(32) double laneMag[4], laneDr[4], laneDi[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneCounts), counts);
+        _mm256_store_pd(laneMag, escapedMag);
+        _mm256_store_pd(laneDr, escapedDr);
+        _mm256_store_pd(laneDi, escapedDi);
+        for (int lane = 0; lane < 4 && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            distances[i + lane] = laneCounts[lane] < maxIter ? distanceEstimate(laneMag[lane], std::hypot(laneDr[lane], laneDi[lane]), pixelsPerUnit) : 0.0f;
+        }
+    }
+}
+
+// Indexed by KernelType; AVX-512 machines run the AVX2 kernel, as for coloring
+const DistanceKernel distanceKernelTable[KERNEL_COUNT] = { estimateDistanceScalar<double>, estimateDistanceAVX2, estimateDistanceAVX2 };
+
+void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<unsigned int>(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long readXCR0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+
+// Checks both the CPU feature bits and that the OS saves the wider register state
+bool isKernelSupported(int kernel) {
+    if (kernel == KERNEL_SCALAR) {
+        return true;
+    }
+
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 7) {
+        return false;
+    }
+
+    cpuid(1, 0, regs);
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+    const bool fma = (regs[2] & (1u << 12)) != 0;
+    if (!osxsave || !avx || !fma) {
+        return false;
+    }
+
+    const unsigned long long xcr0 = readXCR0();
+    cpuid(7, 0, regs);
+
+    if (kernel == KERNEL_AVX2) {
+        return (xcr0 & 0x6) == 0x6 && (regs[1] & (1u << 5)) != 0;
+    }
+    if (kernel == KERNEL_AVX512) {
+        return (xcr0 & 0xE6) == 0xE6 && (regs[1] & (1u << 16)) != 0;
+    }
+    return false;
+}
+
+// Numeric types from cheapest to most precise; each frame uses the first that resolves its pixels
+enum PrecisionLevel { PRECISION_FLOAT, PRECISION_DOUBLE, PRECISION_DOUBLEDOUBLE, PRECISION_BIGNUM, PRECISION_COUNT };
+const char* const precisionNames[PRECISION_COUNT] = { "float", "double", "doubledouble", "bignum" };
+const double precisionEpsilon[PRECISION_COUNT] = { FLT_EPSILON, DBL_EPSILON, DBL_EPSILON * DBL_EPSILON, 0.0 };
+const double PRECISION_GUARD = 256.0; // Headroom for rounding error amplified over many iterations
+
+std::atomic<int> forcedPrecision(-1); // -1 picks the precision automatically
+
+// |z| stays below 2 while iterating, so the representable step near 2 must be well below a pixel
+int choosePrecision(FloatExp pixelSpacing) {
+    if (forcedPrecision.load() >= 0) {
+        return forcedPrecision.load();
+    }
+    for (int level = PRECISION_FLOAT; level < PRECISION_BIGNUM; ++level) {
+        if (pixelSpacing.log2() > std::log2(2.0 * precisionEpsilon[level] * PRECISION_GUARD)) {
+            return level;
+        }
+    }
+    return PRECISION_BIGNUM;
+}
+
+// Fractional limbs needed for the bignum path: the pixel spacing plus 32 guard bits
+int bigFloatPrecisionFor(FloatExp pixelSpacing) {
+    int bits = static_cast<int>(std::ceil(-pixelSpacing.log2())) + 32;
+    return std::min(BIG_LIMBS, std::max(2, (bits + 31) / 32));
+}
+
+int detectBestKernel() {
+    for (int kernel = KERNEL_COUNT - 1; kernel > KERNEL_SCALAR; --kernel) {
+        if (isKernelSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return KERNEL_SCALAR;
+}
+
+// GPU backend: the float, double and double-double escape loops as a D3D11 compute shader.
+// It fills the same iteration and fraction buffers as the CPU kernels, so coloring, the frame
+// cache, panning and profiling work on its frames unchanged. It is opt-in, with "backend gpu" or
+// --backend gpu, which is when the runtime and the shader compiler are loaded; without them, or
+// without a hardware adapter, every frame stays on the CPU. Bignum frames always do, as do double
+// and double-double ones on adapters without doubles.
+enum BackendType { BACKEND_CPU, BACKEND_GPU, BACKEND_COUNT };
+const char* const backendNames[BACKEND_COUNT] = { "cpu", "gpu" };
+
+std::atomic<int> selectedBackend(BACKEND_CPU); // With the GPU, frames it cannot compute fall back to the CPU
+
+const int GPU_GROUP_SIZE = 8; // Threads per group along each axis, matching numthreads in the shader
+const int GPU_BAND_ROWS = 64; // Rows per dispatch, so no dispatch nears the driver timeout and cancelling waits for one band at most
+
+// PRECISION selects the arithmetic: 0 float, 1 double, 2 double-double as double2(hi, lo). The
+// double-double helpers mirror the CPU ones; precise keeps the compiler from contracting or
+// reassociating the error terms away. Each pixel writes its count and the bits of its fraction.
+const char* const gpuShaderSource = R"(
+cbuffer Band : register(b0) {
+    uint width;
+    uint rowEnd;
+    uint rowOffset;
+    uint maxIter;
+};
+
+#if PRECISION == 0
+typedef float real;
+typedef float coordinate;
+#elif PRECISION == 1
+typedef double real;
+typedef double coordinate;
+#else
+typedef double real;
+typedef double2 coordinate;
+#endif
+
+StructuredBuffer<coordinate> columns : register(t0);
+StructuredBuffer<coordinate> rows : register(t1);
+RWStructuredBuffer<uint2> results : register(u0);
+
+bool insideCardioidOrBulb(real x, real y) {
+    real xq = x - 0.25;
+    real q = xq * xq + y * y;
+    if (q * (q + xq) <= 0.25 * y * y) {
+        return true;
+    }
+    real xb = x + 1.0;
+    return xb * xb + y * y <= 0.0625;
+}
+
+#if PRECISION == 2
+double2 quickTwoSum(double a, double b) {
+    precise double s = a + b;
+    precise double e = b - (s - a);
+    return double2(s, e);
+}
+
+double2 twoSum(double a, double b) {
+    precise double s = a + b;
+    precise double bb = s - a;
+    precise double e = (a - (s - bb)) + (b - bb);
+    return double2(s, e);
+}
+
+double2 twoProd(double a, double b) {
+    precise double p = a * b;
+    precise double ta = 134217729.0L * a;
+    precise double ah = ta - (ta - a);
+    precise double al = a - ah;
+    precise double tb = 134217729.0L * b;
+    precise double bh = tb - (tb - b);
+    precise double bl = b - bh;
+    precise double e = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+    return double2(p, e);
+}
+
+double2 ddAdd(double2 a, double2 b) {
+    double2 s = twoSum(a.x, b.x);
+    double2 t = twoSum(a.y, b.y);
+    precise double lo = s.y + t.x;
+    s = quickTwoSum(s.x, lo);
+    lo = s.y + t.y;
+    return quickTwoSum(s.x, lo);
+}
+
+double2 ddMul(double2 a, double2 b) {
+    double2 p = twoProd(a.x, b.x);
+    precise double lo = p.y + (a.x * b.y + a.y * b.x);
+    return quickTwoSum(p.x, lo);
+}
+#endif
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+    const uint py = rowOffset + id.y;
+    if (id.x >= width || py >= rowEnd) {
+        return;
+    }
+
+    const coordinate cx = columns[id.x];
+    const coordinate cy = rows[py];
+    uint n = 0;
+    float magnitude = 0.0f;
+
+#if PRECISION == 2
+    if (insideCardioidOrBulb(cx.x, cy.x)) {
+        n = maxIter;
+    }
+    else {
+        double2 zr = double2(0.0, 0.0);
+        double2 zi = double2(0.0, 0.0);
+        double2 savedR = zr;
+        double2 savedI = zi;
+        uint checkpoint = 1;
+        [loop]
+        while (n < maxIter) {
+            const double2 zr2 = ddMul(zr, zr);
+            const double2 zi2 = ddMul(zi, zi);
+            if (zr2.x + zi2.x > 4.0) {
+                magnitude = (float)(zr2.x + zi2.x);
+                break;
+            }
+            const double2 product = ddMul(zr, zi);
+            zi = ddAdd(ddAdd(product, product), cy);
+            zr = ddAdd(ddAdd(zr2, -zi2), cx);
+            ++n;
+            if (all(zr == savedR) && all(zi == savedI)) {
+                n = maxIter;
+                break;
+            }
+            if (n == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+    }
+#else
+    if (insideCardioidOrBulb(cx, cy)) {
+        n = maxIter;
+    }
+    else {
+        real zr = 0.0;
+        real zi = 0.0;
+        real savedR = zr;
+        real savedI = zi;
+        uint checkpoint = 1;
+        [loop]
+        while (n < maxIter) {
+            const real zr2 = zr * zr;
+            const real zi2 = zi * zi;
+            if (zr2 + zi2 > 4.0) {
+                magnitude = (float)(zr2 + zi2);
+                break;
+            }
+            zi = (zr + zr) * zi + cy;
+            zr = zr2 - zi2 + cx;
+            ++n;
+            if (zr == savedR && zi == savedI) {
+                n = maxIter;
+                break;
+            }
+            if (n == checkpoint) {
+                savedR = zr;
+                savedI = zi;
+                checkpoint *= 2;
+            }
+        }
+    }
+#endif
+
+    float fraction = 0.0f;
+    if (n < maxIter) {
+        fraction = saturate(1.0f - log2(0.5f * log2(magnitude)));
+    }
+    results[py * width + id.x] = uint2(n, asuint(fraction));
+}
+)";
+
+template <typename T>
+void releaseCom(T*& object) {
+    if (object) {
+        object->Release();
+        object = nullptr;
+    }
+}
+
+class GpuBackend {
+public:
+    enum Result { DONE, CANCELLED, FAILED };
+
+    GpuBackend() {
+        initialize();
+    }
+
+    ~GpuBackend() {
+        release();
+    }
+
+    // Safe from any thread; the rest only from the one computing frames
+    bool supports(int precision) const {
+        return precision < PRECISION_BIGNUM && (supported.load() & (1u << precision)) != 0;
+    }
+
+    // Computes the counts and fractions of the width x height pixels c = (column x, row y) into
+    // rows `stride` entries apart. Float and double frames pass their coordinates in columnX and
+    // rowY, double-double frames in columnXdd and rowYdd. A device that fails disables the
+    // backend, so later frames fall back to the CPU.
+    template <typename CancelCheck>
+    Result compute(int precision, const ScratchVector<double>& columnX, const ScratchVector<double>& rowY,
+        const ScratchVector<DoubleDouble>& columnXdd, const ScratchVector<DoubleDouble>& rowYdd,
+        int width, int height, int maxIter, int* iterations, float* fractions, int stride, CancelCheck cancelled) {
+        if (!supports(precision) || !prepareResults(width * height)) {
+            return fail();
+        }
+
+        ID3D11ShaderResourceView* inputs[2] = {};
+        if (precision == PRECISION_FLOAT) {
+            const ScratchVector<float> columns(columnX.begin(), columnX.end());
+            const ScratchVector<float> rows(rowY.begin(), rowY.end());
+            inputs[0] = createInput(columns.data(), width, sizeof(float));
+            inputs[1] = createInput(rows.data(), height, sizeof(float));
+        }
+        else if (precision == PRECISION_DOUBLE) {
+            inputs[0] = createInput(columnX.data(), width, sizeof(double));
+            inputs[1] = createInput(rowY.data(), height, sizeof(double));
+        }
+        else {
+            inputs[0] = createInput(columnXdd.data(), width, sizeof(DoubleDouble));
+            inputs[1] = createInput(rowYdd.data(), height, sizeof(DoubleDouble));
+        }
+        if (!inputs[0] || !inputs[1]) {
+            releaseCom(inputs[0]);
+            releaseCom(inputs[1]);
+            return fail();
+        }
+
+        context->CSSetShader(shaders[precision], nullptr, 0);
+        context->CSSetShaderResources(0, 2, inputs);
+        context->CSSetUnorderedAccessViews(0, 1, &resultsView, nullptr);
+        context->CSSetConstantBuffers(0, 1, &constants);
+
+        Result result = DONE;
+        for (int y0 = 0; y0 < height && result == DONE; y0 += GPU_BAND_ROWS) {
+            const int bandRows = std::min(GPU_BAND_ROWS, height - y0);
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            if (FAILED(context->Map(constants, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+                result = FAILED;
+                break;
+            }
+            const uint32_t band[4] = { static_cast<uint32_t>(width), static_cast<uint32_t>(y0 + bandRows), static_cast<uint32_t>(y0), static_cast<uint32_t>(maxIter) };
+            std::memcpy(mapped.pData, band, sizeof(band));
+            context->Unmap(constants, 0);
+
+            context->Dispatch((width + GPU_GROUP_SIZE - 1) / GPU_GROUP_SIZE, (bandRows + GPU_GROUP_SIZE - 1) / GPU_GROUP_SIZE, 1);
+            context->End(bandDone);
+            HRESULT status;
+            while ((status = context->GetData(bandDone, nullptr, 0, 0)) == S_FALSE) {
+                if (cancelled()) {
+                    result = CANCELLED;
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            if (FAILED(status)) {
+                result = FAILED;
+            }
+        }
+
+        ID3D11ShaderResourceView* const noInputs[2] = {};
+        ID3D11UnorderedAccessView* const noResults = nullptr;
+        context->CSSetShaderResources(0, 2, noInputs);
+        context->CSSetUnorderedAccessViews(0, 1, &noResults, nullptr);
+        releaseCom(inputs[0]);
+        releaseCom(inputs[1]);
+
+        if (result == DONE) {
+            context->CopyResource(staging, results);
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            if (FAILED(context->Map(staging, 0, D3D11_MAP_READ, 0, &mapped))) {
+                return fail();
+            }
+            const uint32_t* pixels = static_cast<const uint32_t*>(mapped.pData);
+            for (int py = 0; py < height; ++py) {
+                for (int px = 0; px < width; ++px) {
+                    const uint32_t* pixel = pixels + 2 * (static_cast<size_t>(py) * width + px);
+                    iterations[py * stride + px] = static_cast<int>(pixel[0]);
+                    std::memcpy(&fractions[py * stride + px], &pixel[1], sizeof(float));
+                }
+            }
+            context->Unmap(staging, 0);
+        }
+        return result == FAILED ? fail() : result;
+    }
+
+private:
+    void initialize() {
+        // Both stay loaded for the life of the process
+        HMODULE runtime = LoadLibraryW(L"d3d11.dll");
+        HMODULE compiler = LoadLibraryW(L"d3dcompiler_47.dll");
+        if (!runtime || !compiler) {
+            return;
+        }
+        auto createDevice = reinterpret_cast<PFN_D3D11_CREATE_DEVICE>(GetProcAddress(runtime, "D3D11CreateDevice"));
+        auto compile = reinterpret_cast<pD3DCompile>(GetProcAddress(compiler, "D3DCompile"));
+        if (!createDevice || !compile) {
+            return;
+        }
+
+        // Runtimes older than 11.1 reject the list that names it, so retry without
+        const D3D_FEATURE_LEVEL levels[] = { D3D_FEATURE_LEVEL_11_1, D3D_FEATURE_LEVEL_11_0 };
+        HRESULT status = createDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0, levels, 2, D3D11_SDK_VERSION, &device, nullptr, &context);
+        if (status == E_INVALIDARG) {
+            status = createDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0, levels + 1, 1, D3D11_SDK_VERSION, &device, nullptr, &context);
+        }
+        if (FAILED(status)) {
+            release();
+            return;
+        }
+
+        // Doubles are optional at feature level 11, and the only way to double-double
+        D3D11_FEATURE_DATA_DOUBLES doubles = {};
+        if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_DOUBLES, &doubles, sizeof(doubles)))) {
+            doubles.DoublePrecisionFloatShaderOps = FALSE;
+        }
+        for (int precision = PRECISION_FLOAT; precision < PRECISION_BIGNUM; ++precision) {
+            if (precision != PRECISION_FLOAT && !doubles.DoublePrecisionFloatShaderOps) {
+                continue;
+            }
+            const char level[2] = { static_cast<char>('0' + precision), 0 };
+            const D3D_SHADER_MACRO defines[] = { { "PRECISION", level }, { nullptr, nullptr } };
+            ID3DBlob* code = nullptr;
+            ID3DBlob* errors = nullptr;
+            if (SUCCEEDED(compile(gpuShaderSource, std::strlen(gpuShaderSource), "escape.hlsl", defines, nullptr, "main", "cs_5_0",
+                D3DCOMPILE_OPTIMIZATION_LEVEL3 | D3DCOMPILE_IEEE_STRICTNESS, 0, &code, &errors))) {
+                device->CreateComputeShader(code->GetBufferPointer(), code->GetBufferSize(), nullptr, &shaders[precision]);
+            }
+            releaseCom(code);
+            releaseCom(errors);
+        }
+
+        D3D11_BUFFER_DESC description = {};
+        description.ByteWidth = 16;
+        description.Usage = D3D11_USAGE_DYNAMIC;
+        description.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        description.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        D3D11_QUERY_DESC query = {};
+        query.Query = D3D11_QUERY_EVENT;
+        if (!shaders[PRECISION_FLOAT] || FAILED(device->CreateBuffer(&description, nullptr, &constants)) ||
+            FAILED(device->CreateQuery(&query, &bandDone))) {
+            release();
+            return;
+        }
+        for (int precision = PRECISION_FLOAT; precision < PRECISION_BIGNUM; ++precision) {
+            if (shaders[precision]) {
+                supported.fetch_or(1u << precision);
+            }
+        }
+    }
+
+    void release() {
+        supported.store(0);
+        for (ID3D11ComputeShader*& shader : shaders) {
+            releaseCom(shader);
+        }
+        releaseCom(resultsView);
+        releaseCom(results);
+        releaseCom(staging);
+        releaseCom(constants);
+        releaseCom(bandDone);
+        releaseCom(context);
+        releaseCom(device);
+        resultCount = 0;
+    }
+
+    Result fail() {
+        release();
+        std::cout << "GPU backend failed; rendering on the CPU.\n";
+        return FAILED;
+    }
+
+    // Sizes the result buffer and its readback copy for `count` pixels
+    bool prepareResults(int count) {
+        if (count == resultCount) {
+            return true;
+        }
+        releaseCom(resultsView);
+        releaseCom(results);
+        releaseCom(staging);
+        resultCount = 0;
+
+        D3D11_BUFFER_DESC description = {};
+        description.ByteWidth = static_cast<UINT>(count) * 8;
+        description.Usage = D3D11_USAGE_DEFAULT;
+        description.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+        description.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        description.StructureByteStride = 8;
+        D3D11_UNORDERED_ACCESS_VIEW_DESC viewDescription = {};
+        viewDescription.Format = DXGI_FORMAT_UNKNOWN;
+        viewDescription.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        viewDescription.Buffer.NumElements = count;
+        if (FAILED(device->CreateBuffer(&description, nullptr, &results)) ||
+            FAILED(device->CreateUnorderedAccessView(results, &viewDescription, &resultsView))) {
+            return false;
+        }
+
+        description.Usage = D3D11_USAGE_STAGING;
+        description.BindFlags = 0;
+        description.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        if (FAILED(device->CreateBuffer(&description, nullptr, &staging))) {
+            return false;
+        }
+        resultCount = count;
+        return true;
+    }
+
+    // Uploads `count` coordinates of `stride` bytes each as a structured buffer
+    ID3D11ShaderResourceView* createInput(const void* data, int count, UINT stride) {
+        D3D11_BUFFER_DESC description = {};
+        description.ByteWidth = static_cast<UINT>(count) * stride;
+        description.Usage = D3D11_USAGE_IMMUTABLE;
+        description.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        description.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        description.StructureByteStride = stride;
+        D3D11_SUBRESOURCE_DATA initial = {};
+        initial.pSysMem = data;
+        D3D11_SHADER_RESOURCE_VIEW_DESC viewDescription = {};
+        viewDescription.Format = DXGI_FORMAT_UNKNOWN;
+        viewDescription.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        viewDescription.Buffer.NumElements = count;
+
+        ID3D11Buffer* buffer = nullptr;
+        ID3D11ShaderResourceView* view = nullptr;
+        if (SUCCEEDED(device->CreateBuffer(&description, &initial, &buffer))) {
+            device->CreateShaderResourceView(buffer, &viewDescription, &view);
+        }
+        releaseCom(buffer);
+        return view;
+    }
+
+    std::atomic<unsigned> supported{ 0 }; // Bit per precision with a working shader
+    ID3D11Device* device = nullptr;
+    ID3D11DeviceContext* context = nullptr;
+    ID3D11ComputeShader* shaders[PRECISION_BIGNUM] = {};
+    ID3D11Buffer* constants = nullptr;
+    ID3D11Buffer* results = nullptr;
+    ID3D11UnorderedAccessView* resultsView = nullptr;
+    ID3D11Buffer* staging = nullptr;
+    ID3D11Query* bandDone = nullptr;
+    int resultCount = 0;
+};
+
+// Created on first use, so the device exists only once something asks for it
+GpuBackend& gpuBackend() {
+    static GpuBackend backend;
+    return backend;
+}
+
+// Reference orbit Z_0..Z_length of the view center for perturbation rendering. It is iterated
+// once in BigFloat and stored as doubles, since every Z stays within the escape radius.
+// Z_length is the first escaped value, or Z_maxIter if the reference never escaped.
+struct ReferenceOrbit {
+    BigFloat cx, cy;
+    int precision;
+    int maxIter;
+    int length;
+    std::vector<double> zr, zi;
+    BigFloat endZr, endZi; // Z_length in full precision, where a longer orbit continues
+
+    // True if this orbit can stand in for one requested at (x, y) with the given settings
+    bool covers(const BigFloat& x, const BigFloat& y, int requiredPrecision, int requiredMaxIter) const {
+        const bool escaped = length < maxIter;
+        return cx == x && cy == y && precision >= requiredPrecision && (escaped || maxIter >= requiredMaxIter);
+    }
+};
+
+const int ORBIT_CANCEL_INTERVAL = 4096; // Iterations between cancel checks of a reference orbit
+
+// Continues `previous`, an unescaped orbit of the same point at the same precision, if given.
+// Once `cancelled` returns true, checked every ORBIT_CANCEL_INTERVAL iterations, the orbit ends
+// as an unescaped orbit of the iterations done so far, which a later call can continue.
+template <typename CancelCheck>
+std::shared_ptr<const ReferenceOrbit> computeReferenceOrbit(const BigFloat& x, const BigFloat& y, int precision, int maxIter, const ReferenceOrbit* previous,
+    CancelCheck cancelled) {
+    auto orbit = std::make_shared<ReferenceOrbit>();
+    orbit->cx = x;
+    orbit->cy = y;
+    orbit->precision = precision;
+    orbit->maxIter = maxIter;
+    orbit->zr.reserve(maxIter + 1);
+    orbit->zi.reserve(maxIter + 1);
+
+    const BigFloat cr = x.withPrecision(precision);
+    const BigFloat ci = y.withPrecision(precision);
+    BigFloat zr(0.0, precision), zi(0.0, precision);
+    int start = 0;
+    if (previous) {
+        orbit->zr.assign(previous->zr.begin(), previous->zr.end());
+        orbit->zi.assign(previous->zi.begin(), previous->zi.end());
+        zr = previous->endZr;
+        zi = previous->endZi;
+        start = previous->length;
+    }
+    else {
+        orbit->zr.push_back(0.0);
+        orbit->zi.push_back(0.0);
+    }
+
+    for (int n = start; n < maxIter; ++n) {
+        if (n > start && (n - start) % ORBIT_CANCEL_INTERVAL == 0 && cancelled()) {
+            orbit->maxIter = n;
+            break;
+        }
+        BigFloat zr2 = zr * zr;
+        BigFloat zi2 = zi * zi;
+        BigFloat zrzi = zr * zi;
+        zi = zrzi + zrzi + ci;
+        zr = zr2 - zi2 + cr;
+
+        double zrd = zr.toDouble();
+        double zid = zi.toDouble();
+        orbit->zr.push_back(zrd);
+        orbit->zi.push_back(zid);
+        if (zrd * zrd + zid * zid > 4.0) {
+            break;
+        }
+    }
+
+    orbit->length = static_cast<int>(orbit->zr.size()) - 1;
+    orbit->endZr = zr;
+    orbit->endZi = zi;
+    return orbit;
+}
+
+std::shared_ptr<const ReferenceOrbit> computeReferenceOrbit(const BigFloat& x, const BigFloat& y, int precision, int maxIter, const ReferenceOrbit* previous = nullptr) {
+    return computeReferenceOrbit(x, y, precision, maxIter, previous, []() { return false; });
+}
+
+std::mutex orbitMutex;
+std::shared_ptr<const ReferenceOrbit> cachedOrbit; // Last reference orbit, reused while the center is unchanged
+std::shared_ptr<const ReferenceOrbit> speculativeOrbit; // Orbit of a view computed ahead, taken over when it is shown
+
+std::shared_ptr<const ReferenceOrbit> getReferenceOrbit(const BigFloat& x, const BigFloat& y, int precision, int maxIter) {
+    std::lock_guard<std::mutex> lock(orbitMutex);
+    ++cacheCounters.orbitLookups;
+    const bool covered = cachedOrbit && cachedOrbit->covers(x, y, precision, maxIter);
+    if (!covered && speculativeOrbit && speculativeOrbit->cx == x && speculativeOrbit->cy == y && speculativeOrbit->precision >= precision) {
+        cachedOrbit = std::move(speculativeOrbit);
+        speculativeOrbit.reset();
+    }
+    if (!cachedOrbit || !cachedOrbit->covers(x, y, precision, maxIter)) {
+        // An orbit of this center that is only too short for the higher limit is extended
+        const bool extend = cachedOrbit && cachedOrbit->cx == x && cachedOrbit->cy == y && cachedOrbit->precision >= precision;
+        cacheCounters.orbitExtensions += extend;
+        cachedOrbit = extend ? computeReferenceOrbit(x, y, cachedOrbit->precision, maxIter, cachedOrbit.get()) : computeReferenceOrbit(x, y, precision, maxIter);
+    }
+    else {
+        ++cacheCounters.orbitHits;
+    }
+    return cachedOrbit;
+}
+
+// Perturbation kernels iterate each pixel's offset delta from the reference orbit:
+// z = Z + delta, delta' = (2Z + delta) * delta + dc. When |z| drops below |delta| the delta has
+// lost its precision against Z (a glitch), so the pixel rebases onto the start of the orbit
+// with delta = z. The same rebase happens when the pixel outlives the reference orbit.
+// Every pixel in a batch starts at iteration startIter with the delta and reference index in
+// states[i]: the series prediction at index startIter for a new frame (0 without a series), or
+// where the pixel stopped when continuing to a higher limit. The states are updated in place.
+typedef void (*PerturbationKernel)(const ReferenceOrbit& orbit, const double* dcx, const double* dcy,
+    int startIter, int count, int maxIter, int* iterations, float* magnitudes, OrbitState* states);
+
+// Continues one pixel from the delta and reference index in `state` at iteration n and returns
+// its iteration count; |z|^2 at escape goes to `magnitude` and `state` keeps where it stopped
+int perturbPixel(const ReferenceOrbit& orbit, OrbitState& state, double dcr, double dci, int n, int maxIter, float& magnitude) {
+    const double* refR = orbit.zr.data();
+    const double* refI = orbit.zi.data();
+    double dr = state.zr;
+    double di = state.zi;
+    int m = state.reference;
+
+    while (n < maxIter) {
+        double Zr = refR[m];
+        double Zi = refI[m];
+        double zr = Zr + dr;
+        double zi = Zi + di;
+        double mag = zr * zr + zi * zi;
+        if (mag > 4.0) {
+            magnitude = static_cast<float>(mag);
+            break;
+        }
+
+        if (mag < dr * dr + di * di || m == orbit.length) {
+            dr = zr;
+            di = zi;
+            Zr = 0.0;
+            Zi = 0.0;
+            m = 0;
+        }
+
+        double tr = 2.0 * Zr + dr;
+        double ti = 2.0 * Zi + di;
+        double ndr = tr * dr - ti * di + dcr;
+        di = tr * di + ti * dr + dci;
+        dr = ndr;
+        ++m;
+        ++n;
+    }
+
+    state.zr = dr;
+    state.zi = di;
+    state.reference = m;
+    state.settled = false;
+    return n;
+}
+
+void perturbScalar(const ReferenceOrbit& orbit, const double* dcx, const double* dcy,
+    int startIter, int count, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    for (int i = 0; i < count; ++i) {
+        iterations[i] = perturbPixel(orbit, states[i], dcx[i], dcy[i], startIter, maxIter, magnitudes[i]);
+    }
+}
+
+// Distance kernel on perturbation deltas, for bignum views. Only z = Z + delta enters the
+// derivative, so it stays a double. Pixels start at iteration 0, as the series approximation
+// carries no derivative.
+void perturbDistance(const ReferenceOrbit& orbit, const double* dcx, const double* dcy, int count, int maxIter, double pixelsPerUnit, int* iterations, float* distances) {
+    const double* refR = orbit.zr.data();
+    const double* refI = orbit.zi.data();
+    for (int i = 0; i < count; ++i) {
+        double dr = 0.0, di = 0.0;
+        double ddr = 0.0, ddi = 0.0;
+        int m = 0, n = 0;
+        distances[i] = 0.0f;
+
+        while (n < maxIter) {
+            double Zr = refR[m];
+            double Zi = refI[m];
+            double zr = Zr + dr;
+            double zi = Zi + di;
+            double mag = zr * zr + zi * zi;
+            if (mag > DISTANCE_BAILOUT) {
+                distances[i] = distanceEstimate(mag, std::hypot(ddr, ddi), pixelsPerUnit);
+                break;
+            }
+
+            if (mag < dr * dr + di * di || m == orbit.length) {
+                dr = zr;
+                di = zi;
+                Zr = 0.0;
+                Zi = 0.0;
+                m = 0;
+            }
+
+            const double sr = zr * ddr - zi * ddi;
+            const double si = zr * ddi + zi * ddr;
+            ddr = sr + sr + 1.0;
+            ddi = si + si;
+
+            double tr = 2.0 * Zr + dr;
+            double ti = 2.0 * Zi + di;
+            double ndr = tr * dr - ti * di + dcx[i];
+            di = tr * di + ti * dr + dcy[i];
+            dr = ndr;
+            ++m;
+            ++n;
+        }
+
+        iterations[i] = n;
+    }
+}
+
+// Lanes rebase independently, so each lane gathers Z from its own reference index
+TARGET_AVX2 void perturbAVX2(const ReferenceOrbit& orbit, const double* dcx, const double* dcy,
+    int startIter, int count, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    const double* refR = orbit.zr.data();
+    const double* refI = orbit.zi.data();
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256i last = _mm256_set1_epi64x(orbit.length);
+    const __m256i one = _mm256_set1_epi64x(1);
+
+    for (int i = 0; i < count; i += 4) {
+        alignas(32) double laneX[4], laneY[4], laneDx[4], laneDy[4];
+        alignas(32) long long laneRef[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = dcx[src];
+            laneY[lane] = dcy[src];
+            laneDx[lane] = states[src].zr;
+            laneDy[lane] = states[src].zi;
+            laneRef[lane] = states[src].reference;
+        }
+
+        const __m256d dcr = _mm256_load_pd(laneX);
+        const __m256d dci = _mm256_load_pd(laneY);
+        __m256d dr = _mm256_load_pd(laneDx);
+        __m256d di = _mm256_load_pd(laneDy);
+        __m256i m = _mm256_load_si256(reinterpret_cast<const __m256i*>(laneRef));
+        __m256i counts = _mm256_set1_epi64x(startIter);
+        __m256d escapedMag = _mm256_setzero_pd();
+        __m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+        for (int n = startIter; n < maxIter; ++n) {
+            __m256d Zr = _mm256_i64gather_pd(refR, m, 8);
+            __m256d Zi = _mm256_i64gather_pd(refI, m, 8);
+            __m256d zr = _mm256_add_pd(Zr, dr);
+            __m256d zi = _mm256_add_pd(Zi, di);
+            __m256d mag = _mm256_fmadd_pd(zr, zr, _mm256_mul_pd(zi, zi));
+
+            __m256d inside = _mm256_cmp_pd(mag, four, _CMP_LE_OQ);
+            escapedMag = _mm256_blendv_pd(escapedMag, mag, _mm256_andnot_pd(inside, active));
+            active = _mm256_and_pd(active, inside);
+            if (_mm256_movemask_pd(active) == 0) {
+                break;
+            }
+            counts = _mm256_sub_epi64(counts, _mm256_castpd_si256(active));
+
+            __m256d deltaMag = _mm256_fmadd_pd(dr, dr, _mm256_mul_pd(di, di));
+            __m256d rebase = _mm256_or_pd(_mm256_cmp_pd(mag, deltaMag, _CMP_LT_OQ), _mm256_castsi256_pd(_mm256_cmpeq_epi64(m, last)));
+            dr = _mm256_blendv_pd(dr, zr, rebase);
+            di = _mm256_blendv_pd(di, zi, rebase);
+            Zr = _mm256_andnot_pd(rebase, Zr);
+            Zi = _mm256_andnot_pd(rebase, Zi);
+            m = _mm256_andnot_si256(_mm256_castpd_si256(rebase), m);
+
+            __m256d tr = _mm256_fmadd_pd(two, Zr, dr);
+            __m256d ti = _mm256_fmadd_pd(two, Zi, di);
+            __m256d ndr = _mm256_add_pd(_mm256_fmsub_pd(tr, dr, _mm256_mul_pd(ti, di)), dcr);
+            di = _mm256_add_pd(_mm256_fmadd_pd(tr, di, _mm256_mul_pd(ti, dr)), dci);
+            dr = ndr;
+            m = _mm256_add_epi64(m, one);
+        }
+
+        alignas(32) long long laneCounts[4];
+        alignas(32) double laneMag[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneCounts), counts);
+        _mm256_store_pd(laneMag, escapedMag);
+        _mm256_store_pd(laneDx, dr);
+        _mm256_store_pd(laneDy, di);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(laneRef), m);
+        for (int lane = 0; lane < 4 && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            magnitudes[i + lane] = static_cast<float>(laneMag[lane]);
+            states[i + lane].zr = laneDx[lane];
+            states[i + lane].zi = laneDy[lane];
+            states[i + lane].reference = static_cast<int>(laneRef[lane]);
+            states[i + lane].settled = false;
+        }
+    }
+}
+
+TARGET_AVX512 void perturbAVX512(const ReferenceOrbit& orbit, const double* dcx, const double* dcy,
+    int startIter, int count, int maxIter, int* iterations, float* magnitudes, OrbitState* states) {
+    const double* refR = orbit.zr.data();
+    const double* refI = orbit.zi.data();
+    const __m512d four = _mm512_set1_pd(4.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512i last = _mm512_set1_epi64(orbit.length);
+    const __m512i one = _mm512_set1_epi64(1);
+
+    for (int i = 0; i < count; i += 8) {
+        alignas(64) double laneX[8], laneY[8], laneDx[8], laneDy[8];
+        alignas(64) long long laneRef[8];
+        for (int lane = 0; lane < 8; ++lane) {
+            int src = std::min(i + lane, count - 1);
+            laneX[lane] = dcx[src];
+            laneY[lane] = dcy[src];
+            laneDx[lane] = states[src].zr;
+            laneDy[lane] = states[src].zi;
+            laneRef[lane] = states[src].reference;
+        }
+
+        const __m512d dcr = _mm512_load_pd(laneX);
+        const __m512d dci = _mm512_load_pd(laneY);
+        __m512d dr = _mm512_load_pd(laneDx);
+        __m512d di = _mm512_load_pd(laneDy);
+        __m512i m = _mm512_load_si512(laneRef);
+        __m512i counts = _mm512_set1_epi64(startIter);
+        __m512d escapedMag = _mm512_setzero_pd();
+        __mmask8 active = 0xFF;
+
+        for (int n = startIter; n < maxIter; ++n) {
+            __m512d Zr = _mm512_i64gather_pd(m, refR, 8);
+            __m512d Zi = _mm512_i64gather_pd(m, refI, 8);
+            __m512d zr = _mm512_add_pd(Zr, dr);
+            __m512d zi = _mm512_add_pd(Zi, di);
+            __m512d mag = _mm512_fmadd_pd(zr, zr, _mm512_mul_pd(zi, zi));
+
+            __mmask8 inside = _mm512_cmp_pd_mask(mag, four, _CMP_LE_OQ);
+            escapedMag = _mm512_mask_mov_pd(escapedMag, static_cast<__mmask8>(active & ~inside), mag);
+            active = static_cast<__mmask8>(active & inside);
+            if (active == 0) {
+                break;
+            }
+            counts = _mm512_mask_add_epi64(counts, active, counts, one);
+
+            __m512d deltaMag = _mm512_fmadd_pd(dr, dr, _mm512_mul_pd(di, di));
+            __mmask8 rebase = _mm512_cmp_pd_mask(mag, deltaMag, _CMP_LT_OQ) | _mm512_cmpeq_epi64_mask(m, last);
+            dr = _mm512_mask_mov_pd(dr, rebase, zr);
+            di = _mm512_mask_mov_pd(di, rebase, zi);
+            Zr = _mm512_mask_mov_pd(Zr, rebase, _mm512_setzero_pd());
+            Zi = _mm512_mask_mov_pd(Zi, rebase, _mm512_setzero_pd());
+            m = _mm512_mask_mov_epi64(m, rebase, _mm512_setzero_si512());
+
+            __m512d tr = _mm512_fmadd_pd(two, Zr, dr);
+            __m512d ti = _mm512_fmadd_pd(two, Zi, di);
+            __m512d ndr = _mm512_add_pd(_mm512_fmsub_pd(tr, dr, _mm512_mul_pd(ti, di)), dcr);
+            di = _mm512_add_pd(_mm512_fmadd_pd(tr, di, _mm512_mul_pd(ti, dr)), dci);
+            dr = ndr;
+            m = _mm512_add_epi64(m, one);
+        }
+
+        alignas(64) long long laneCounts[8];
+        alignas(64) double laneMag[8];
+        _mm512_store_si512(laneCounts, counts);
+        _mm512_store_pd(laneMag, escapedMag);
+        _mm512_store_pd(laneDx, dr);
+        _mm512_store_pd(laneDy, di);
+        _mm512_store_si512(laneRef, m);
+        for (int lane = 0; lane < 8 && i + lane < count; ++lane) {
+            iterations[i + lane] = static_cast<int>(laneCounts[lane]);
+            magnitudes[i + lane] = static_cast<float>(laneMag[lane]);
+            states[i + lane].zr = laneDx[lane];
+            states[i + lane].zi = laneDy[lane];
+            states[i + lane].reference = static_cast<int>(laneRef[lane]);
+            states[i + lane].settled = false;
+        }
+    }
+}
+
+const PerturbationKernel perturbationKernelTable[KERNEL_COUNT] = { perturbScalar, perturbAVX2, perturbAVX512 };
+
+const int FLOATEXP_SPACING_EXPONENT = -960; // Below 2^-960 pixel deltas leave the double range
+const int DOUBLE_SAFE_EXPONENT = -900; // FloatExp deltas this large continue in plain doubles
+
+// Perturbation with FloatExp deltas for zooms past the double range. Deltas grow roughly
+// geometrically along the orbit, so each pixel switches to perturbPixel() once its delta fits.
+int perturbFloatExp(const ReferenceOrbit& orbit, FloatExp dcr, FloatExp dci, FloatExp dr, FloatExp di, int startIter, int maxIter, float& magnitude) {
+    int m = startIter;
+    int n = startIter;
+
+    while (n < maxIter) {
+        const bool nonZero = dr.mantissa != 0.0 || di.mantissa != 0.0;
+        if (nonZero && std::max(dr.exponent, di.exponent) > DOUBLE_SAFE_EXPONENT) {
+            OrbitState state = { dr.toDouble(), di.toDouble(), 0.0, 0.0, m, false };
+            return perturbPixel(orbit, state, dcr.toDouble(), dci.toDouble(), n, maxIter, magnitude);
+        }
+
+        double Zr = orbit.zr[m];
+        double Zi = orbit.zi[m];
+        double zr = Zr + dr.toDouble();
+        double zi = Zi + di.toDouble();
+        double mag = zr * zr + zi * zi;
+        if (mag > 4.0) {
+            magnitude = static_cast<float>(mag);
+            break;
+        }
+
+        if (FloatExp(mag) < dr * dr + di * di || m == orbit.length) {
+            dr = FloatExp(zr);
+            di = FloatExp(zi);
+            Zr = 0.0;
+            Zi = 0.0;
+            m = 0;
+        }
+
+        FloatExp tr = FloatExp(2.0 * Zr) + dr;
+        FloatExp ti = FloatExp(2.0 * Zi) + di;
+        FloatExp ndr = tr * dr - ti * di + dcr;
+        di = tr * di + ti * dr + dci;
+        dr = ndr;
+        ++m;
+        ++n;
+    }
+
+    return n;
+}
+
+std::atomic<bool> usePerturbation(true); // Past double-double, perturb around one reference orbit
+
+// Series approximation: near the reference orbit every pixel's delta after n iterations is
+// well predicted by delta_n = A_n dc + B_n dc^2 + C_n dc^3, with
+//   A_{n+1} = 2 Z_n A_n + 1,  B_{n+1} = 2 Z_n B_n + A_n^2,  C_{n+1} = 2 Z_n C_n + 2 A_n B_n.
+// Pixels then start their loop at iteration `skip` instead of 0. The coefficients are carried
+// in FloatExp as a = A s, b = B s^2, c = C s^3 for the view radius s, so they stay in range.
+const double SERIES_TOLERANCE = 1e-12; // Largest accepted relative error of a probe's predicted delta
+
+struct SeriesApproximation {
+    int skip = 0;
+    int exponent = 0; // The coefficients below are scaled by 2^-exponent
+    FloatExp radius;
+    double ar = 0, ai = 0, br = 0, bi = 0, cr = 0, ci = 0;
+
+    // offset / radius as a plain double (0 when no series was computed)
+    double relative(FloatExp offset) const {
+        return (offset.mantissa == 0.0 || radius.mantissa == 0.0) ? 0.0 : std::ldexp(offset.mantissa / radius.mantissa, offset.exponent - radius.exponent);
+    }
+
+    // Predicted delta at iteration `skip` for u = dc / radius, scaled by 2^-exponent
+    void evaluate(double ur, double ui, double& dr, double& di) const {
+        double u2r = ur * ur - ui * ui, u2i = 2.0 * ur * ui;
+        double u3r = u2r * ur - u2i * ui, u3i = u2r * ui + u2i * ur;
+        dr = ar * ur - ai * ui + br * u2r - bi * u2i + cr * u3r - ci * u3i;
+        di = ar * ui + ai * ur + br * u2i + bi * u2r + cr * u3i + ci * u3r;
+    }
+};
+
+inline void complexMul(FloatExp ar, FloatExp ai, FloatExp br, FloatExp bi, FloatExp& rr, FloatExp& ri) {
+    FloatExp real = ar * br - ai * bi;
+    ri = ar * bi + ai * br;
+    rr = real;
+}
+
+// Advances the coefficients while probe pixels on the view border, iterated exactly, still agree
+// with the series. Stops before any probe escapes or would need a rebase.
+SeriesApproximation computeSeriesApproximation(const ReferenceOrbit& orbit, FloatExp halfWidth, FloatExp halfHeight, int maxIter) {
+    SeriesApproximation series;
+    series.radius = halfWidth < halfHeight ? halfHeight : halfWidth;
+    const double uw = series.relative(halfWidth);
+    const double uh = series.relative(halfHeight);
+
+    const int PROBES = 8;
+    const double probeU[PROBES][2] = {
+        { -uw, -uh }, { uw, -uh }, { -uw, uh }, { uw, uh }, { 0, -uh }, { 0, uh }, { -uw, 0 }, { uw, 0 }
+    };
+    FloatExp probeDr[PROBES], probeDi[PROBES], probeCr[PROBES], probeCi[PROBES];
+    for (int p = 0; p < PROBES; ++p) {
+        probeCr[p] = series.radius * probeU[p][0];
+        probeCi[p] = series.radius * probeU[p][1];
+    }
+
+    FloatExp ar, ai, br, bi, cr, ci;
+    const int limit = std::min(maxIter, orbit.length);
+    for (int n = 0; n < limit; ++n) {
+        const double Zr = orbit.zr[n], Zi = orbit.zi[n];
+        const FloatExp twoZr(2.0 * Zr), twoZi(2.0 * Zi);
+
+        FloatExp nar, nai, nbr, nbi, ncr, nci, tr, ti;
+        complexMul(twoZr, twoZi, ar, ai, nar, nai);
+        nar = nar + series.radius;
+        complexMul(twoZr, twoZi, br, bi, nbr, nbi);
+        complexMul(ar, ai, ar, ai, tr, ti);
+        nbr = nbr + tr;
+        nbi = nbi + ti;
+        complexMul(twoZr, twoZi, cr, ci, ncr, nci);
+        complexMul(ar, ai, br, bi, tr, ti);
+        ncr = ncr + tr * 2.0;
+        nci = nci + ti * 2.0;
+
+        bool valid = true;
+        for (int p = 0; p < PROBES && valid; ++p) {
+            FloatExp dr = probeDr[p], di = probeDi[p];
+            double zr = Zr + dr.toDouble(), zi = Zi + di.toDouble();
+            double mag = zr * zr + zi * zi;
+            if (mag > 4.0 || FloatExp(mag) < dr * dr + di * di) {
+                valid = false;
+                break;
+            }
+
+            // Exact next delta for the probe
+            FloatExp sr = twoZr + dr, si = twoZi + di, ndr, ndi;
+            complexMul(sr, si, dr, di, ndr, ndi);
+            probeDr[p] = ndr + probeCr[p];
+            probeDi[p] = ndi + probeCi[p];
+
+            // Series prediction for the same probe
+            const double ur = probeU[p][0], ui = probeU[p][1];
+            const double u2r = ur * ur - ui * ui, u2i = 2.0 * ur * ui;
+            const double u3r = u2r * ur - u2i * ui, u3i = u2r * ui + u2i * ur;
+            FloatExp predr = nar * ur - nai * ui + nbr * u2r - nbi * u2i + ncr * u3r - nci * u3i;
+            FloatExp predi = nar * ui + nai * ur + nbr * u2i + nbi * u2r + ncr * u3i + nci * u3r;
+
+            FloatExp er = predr - probeDr[p], ei = predi - probeDi[p];
+            FloatExp error = er * er + ei * ei;
+            FloatExp scale = (probeDr[p] * probeDr[p] + probeDi[p] * probeDi[p]) * (SERIES_TOLERANCE * SERIES_TOLERANCE);
+            if (scale < error) {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            break;
+        }
+
+        ar = nar; ai = nai; br = nbr; bi = nbi; cr = ncr; ci = nci;
+        series.skip = n + 1;
+    }
+
+    // Bring the coefficients to a common exponent so pixels can evaluate them in doubles
+    series.exponent = std::max({ ar.exponent, ai.exponent, br.exponent, bi.exponent, cr.exponent, ci.exponent });
+    auto scaled = [&](FloatExp v) { return std::ldexp(v.mantissa, v.exponent - series.exponent); };
+    series.ar = scaled(ar); series.ai = scaled(ai);
+    series.br = scaled(br); series.bi = scaled(bi);
+    series.cr = scaled(cr); series.ci = scaled(ci);
+    return series;
+}
+
+std::atomic<bool> useSeriesApproximation(true); // Skip the iterations the series predicts
+
+// Function to calculate the color based on iteration count and max iterations
+COLORREF getColor(int iterations, int maxIter, bool color) {
+    if (iterations == maxIter) {
+        return RGB(0, 0, 0);  // Black for points inside the set
+    }
+
+    double t = static_cast<double>(iterations) / maxIter;
+
+    if (color) {
+        // Color mode
+        int r = static_cast<int>(9 * (1 - t) * t * t * t * 255);
+        int g = static_cast<int>(15 * (1 - t) * (1 - t) * t * t * 255);
+        int b = static_cast<int>(8.5 * (1 - t) * (1 - t) * (1 - t) * t * 255);
+
+        // Dynamically adjust the color intensity based on the iteration count
+        int maxColorValue = 255;
+        r = (r > maxColorValue) ? maxColorValue : r;
+        g = (g > maxColorValue) ? maxColorValue : g;
+        b = (b > maxColorValue) ? maxColorValue : b;
+
+        return RGB(r, g, b);
+    }
+    else {
+        // Grayscale mode
+        int gray = static_cast<int>(255 * t);
+        return RGB(gray, gray, gray);  // Return grayscale color
+    }
+}
+
+// User-loaded gradient: evenly spaced color stops spanning the iteration range
+std::mutex gradientMutex;
+std::vector<COLORREF> gradientStops;
+std::atomic<unsigned> gradientVersion(0); // Bumped on every load so cached palettes rebuild
+std::atomic<bool> useGradient(false); // Color mode uses the loaded gradient instead of the built-in formula
+
+// Reads one "r g b" stop (0-255 each) per line; blank lines and lines starting with '#' are skipped
+bool loadGradient(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    std::vector<COLORREF> stops;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        int r, g, b;
+        if (!(fields >> r >> g >> b)) {
+            return false;
+        }
+        auto clamp = [](int v) { return std::min(std::max(v, 0), 255); };
+        stops.push_back(RGB(clamp(r), clamp(g), clamp(b)));
+    }
+    if (stops.size() < 2) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(gradientMutex);
+    gradientStops.swap(stops);
+    ++gradientVersion;
+    return true;
+}
+
+COLORREF gradientColor(const std::vector<COLORREF>& stops, int iterations, int maxIter) {
+    if (iterations == maxIter) {
+        return RGB(0, 0, 0);
+    }
+
+    double position = static_cast<double>(iterations) / maxIter * (stops.size() - 1);
+    size_t index = std::min(static_cast<size_t>(position), stops.size() - 2);
+    double f = position - index;
+    auto blend = [f](int a, int b) { return static_cast<int>(a + (b - a) * f + 0.5); };
+    COLORREF a = stops[index], b = stops[index + 1];
+    return RGB(blend(GetRValue(a), GetRValue(b)), blend(GetGValue(a), GetGValue(b)), blend(GetBValue(a), GetBValue(b)));
+}
+
+// Palette baked for one iteration limit, indexed directly by iteration count. Only the render
+// thread touches it, and it is rebuilt only when the limit or the palette settings change.
+struct PaletteLUT {
+    int maxIter = -1;
+    bool color = false;
+    bool gradient = false;
+    unsigned version = 0;
+    std::vector<COLORREF> colors; // maxIter + 1 entries
+};
+
+PaletteLUT paletteLUT;
+
+const PaletteLUT& currentPalette(int maxIter, bool color, bool gradient) {
+    const unsigned version = gradientVersion.load();
+    PaletteLUT& lut = paletteLUT;
+    ++cacheCounters.paletteLookups;
+    if (lut.maxIter == maxIter && lut.color == color && lut.gradient == gradient && (!gradient || lut.version == version)) {
+        ++cacheCounters.paletteHits;
+        return lut;
+    }
+
+    lut.maxIter = maxIter;
+    lut.color = color;
+    lut.gradient = gradient;
+    lut.version = version;
+    lut.colors.resize(maxIter + 1);
+
+    std::lock_guard<std::mutex> lock(gradientMutex);
+    for (int n = 0; n <= maxIter; ++n) {
+        lut.colors[n] = gradient ? gradientColor(gradientStops, n, maxIter) : getColor(n, maxIter, color);
+    }
+    return lut;
+}
+
+// Color kernels map `count` iteration counts to pixels through the palette. With smooth
+// coloring, escaped pixels blend toward the next entry by their fractional iteration.
+typedef void (*ColorKernel)(const int* iterations, const float* fractions, int count, const COLORREF* palette, int maxIter, bool smooth, COLORREF* pixels);
+
+void colorizeScalar(const int* iterations, const float* fractions, int count, const COLORREF* palette, int maxIter, bool smooth, COLORREF* pixels) {
+    for (int i = 0; i < count; ++i) {
+        const int n = iterations[i];
+        COLORREF color = palette[n];
+        if (smooth && n < maxIter) {
+            const COLORREF next = palette[std::max(std::min(n + 1, maxIter - 1), 0)];
+            const float f = fractions[i];
+            auto blend = [f](int a, int b) { return static_cast<int>(a + (b - a) * f + 0.5f); };
+            color = RGB(blend(GetRValue(color), GetRValue(next)), blend(GetGValue(color), GetGValue(next)), blend(GetBValue(color), GetBValue(next)));
+        }
+        pixels[i] = color;
+    }
+}
+
+// Gathers 8 palette entries per step; the blend runs per 8-bit channel in float lanes
+TARGET_AVX2 void colorizeAVX2(const int* iterations, const float* fractions, int count, const COLORREF* palette, int maxIter, bool smooth, COLORREF* pixels) {
+    const int* table = reinterpret_cast<const int*>(palette);
+    const __m256i limit = _mm256_set1_epi32(maxIter);
+    const __m256i lastEscaped = _mm256_set1_epi32(std::max(maxIter - 1, 0));
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i channelMask = _mm256_set1_epi32(0xFF);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(iterations + i));
+        __m256i color = _mm256_i32gather_epi32(table, n, 4);
+
+        if (smooth) {
+            const __m256i escaped = _mm256_cmpgt_epi32(limit, n);
+            const __m256i nextIndex = _mm256_min_epi32(_mm256_add_epi32(n, one), lastEscaped);
+            const __m256i next = _mm256_i32gather_epi32(table, nextIndex, 4);
+            const __m256 f = _mm256_and_ps(_mm256_loadu_ps(fractions + i), _mm256_castsi256_ps(escaped));
+
+            __m256i blended = _mm256_setzero_si256();
+            for (int shift = 0; shift < 24; shift += 8) {
+                __m256 a = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(color, shift), channelMask));
+                __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(next, shift), channelMask));
+                __m256 channel = _mm256_add_ps(_mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), f)), half);
+                blended = _mm256_or_si256(blended, _mm256_slli_epi32(_mm256_cvttps_epi32(channel), shift));
+            }
+            color = blended;
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), color);
+    }
+
+    colorizeScalar(iterations + i, fractions + i, count - i, palette, maxIter, smooth, pixels + i);
+}
+
+const ColorKernel colorKernelTable[KERNEL_COUNT] = { colorizeScalar, colorizeAVX2, colorizeAVX2 };
+
+// Distance mode shades escaped pixels by the fraction instead, from the set's color on the
+// boundary to the middle of the palette DISTANCE_EDGE pixels away and beyond
+inline COLORREF distanceColor(const COLORREF* palette, int maxIter, float shade) {
+    const COLORREF edge = palette[maxIter], background = palette[maxIter / 2];
+    auto blend = [shade](int a, int b) { return static_cast<int>(a + (b - a) * shade + 0.5f); };
+    return RGB(blend(GetRValue(edge), GetRValue(background)), blend(GetGValue(edge), GetGValue(background)), blend(GetBValue(edge), GetBValue(background)));
+}
+
+void colorizeDistance(const int* iterations, const float* fractions, int count, const COLORREF* palette, int maxIter, bool, COLORREF* pixels) {
+    for (int i = 0; i < count; ++i) {
+        pixels[i] = iterations[i] == maxIter ? palette[maxIter] : distanceColor(palette, maxIter, fractions[i]);
+    }
+}
+
+// Fractional part of the continuous iteration count n + 1 - log_p(log2|z|), from |z|^2 at escape,
+// for formulas raising z to the power p; logPower is log2(p)
+inline float smoothFraction(float magnitude, float logPower = 1.0f) {
+    float f = 1.0f - std::log2(0.5f * std::log2(magnitude)) / logPower;
+    return std::min(std::max(f, 0.0f), 1.0f);
+}
+
+// Shade of an escaped pixel in distance mode, from its estimate b in pixels: 0 on the set's
+// boundary up to 1 from DISTANCE_EDGE pixels away
+inline float distanceShade(float distance) {
+    return distance > 0.0f ? std::min(distance / DISTANCE_EDGE, 1.0f) : 0.0f;
+}
+
+// Everything one frame depends on, copied under viewMutex when the render thread picks up a
+// request, so later clicks and commands cannot change a frame halfway through
+struct ViewSnapshot {
+    BigFloat centerX, centerY;
+    long long panX, panY;
+    FloatExp viewWidth, viewHeight;
+    int width, height;
+    int maxIter;
+    int kernel;
+    int backend;
+    int precision;
+    int samples; // Anti-aliasing samples per pixel at edges: 1, 4 or 16
+    int formula;
+    double juliaX, juliaY; // Julia constant, for FORMULA_JULIA
+    bool perturbation, series, progressive, subdivide;
+    bool distance; // Distance estimation: the fractions hold distanceShade() of each escaped pixel
+    bool color, gradient, smooth;
+};
+
+// True if the view's pixels come from the GPU backend rather than the CPU kernels
+bool usesGpu(const ViewSnapshot& view) {
+    return view.backend == BACKEND_GPU && view.formula == FORMULA_MANDELBROT && !view.distance && gpuBackend().supports(view.precision);
+}
+
+// The color kernel for the view's buffers
+ColorKernel colorKernelFor(const ViewSnapshot& view) {
+    return view.distance ? colorizeDistance : colorKernelTable[view.kernel];
+}
+
+// For callers that already hold viewMutex, such as one that changes the view from its snapshot
+ViewSnapshot takeSnapshotLocked() {
+    ViewSnapshot view;
+    view.centerX = centerX;
+    view.centerY = centerY;
+    view.panX = panX;
+    view.panY = panY;
+    view.viewWidth = viewWidth;
+    view.viewHeight = viewHeight;
+    view.width = frameWidth;
+    view.height = frameHeight;
+    view.formula = currentFormula;
+    view.juliaX = juliaX;
+    view.juliaY = juliaY;
+    view.maxIter = currentMaxIter.load();
+    view.kernel = selectedKernel.load();
+    view.backend = selectedBackend.load();
+    view.precision = choosePrecision(std::min(view.viewWidth * (1.0 / view.width), view.viewHeight * (1.0 / view.height)));
+    // Perturbation, its series approximation and the distance estimate are derived for z^2 + c
+    // only. Distance estimates stay crisp at one sample per pixel and need no anti-aliasing.
+    view.perturbation = usePerturbation.load() && view.formula == FORMULA_MANDELBROT;
+    view.series = useSeriesApproximation.load();
+    view.distance = useDistanceEstimation.load() && view.formula == FORMULA_MANDELBROT;
+    view.samples = view.distance ? 1 : antialiasSamples.load();
+    view.progressive = useProgressive.load();
+    view.subdivide = useSubdivision.load() && formulaConnected[view.formula];
+    view.color = useColor.load();
+    view.gradient = view.color && useGradient.load();
+    view.smooth = useSmoothColoring.load();
+    return view;
+}
+
+ViewSnapshot takeSnapshot() {
+    std::lock_guard<std::mutex> lock(viewMutex);
+    return takeSnapshotLocked();
+}
+
+// Pixel rectangle [x0, x1) x [y0, y1) of a frame
+struct PixelRect {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    bool contains(int x, int y) const {
+        return x >= x0 && x < x1 && y >= y0 && y < y1;
+    }
+};
+
+// Fills every pixel of an unfinished pass from the sample at the top-left of its step x step
+// block. Pixels in `reused`, and those `known` marks if given, are already final and stay untouched.
+void fillPreview(int step, const PixelRect& reused, const unsigned char* known = nullptr) {
+    renderPool->parallelFor(bufferHeight, [&](int py) {
+        const int sourceRow = (py - py % step) * bufferStride;
+        for (int px = 0; px < bufferWidth; ++px) {
+            const int source = sourceRow + px - px % step;
+            const int target = py * bufferStride + px;
+            if (source == target || reused.contains(px, py) || (known && known[target])) {
+                continue;
+            }
+            iterationBuffer[target] = iterationBuffer[source];
+            smoothBuffer[target] = smoothBuffer[source];
+        }
+        });
+}
+
+// Recently finished frames. Two frames share pixels when everything but the pan matches; the
+// iteration limit is part of the key, since counts at a different limit are not the same frame.
+struct CachedFrame {
+    ViewSnapshot view;
+    AlignedVector<int> iterations;
+    AlignedVector<float> fractions;
+    unsigned long long lastUse = 0;
+};
+
+std::vector<CachedFrame> frameCache; // Only the render thread touches it
+unsigned long long frameCacheClock = 0;
+
+// Progressive passes down to CLICK_PREVIEW_STEP of the view a click on the hovered pixel would
+// show, computed while the cursor rests. Only the render thread touches them.
+CachedFrame clickPreview;
+bool clickPreviewValid = false;
+
+// True if the views share one pixel grid, whatever their pan and iteration limit
+bool sameCoordinates(const ViewSnapshot& a, const ViewSnapshot& b) {
+    if (!(a.centerX == b.centerX && a.centerY == b.centerY)) {
+        return false;
+    }
+    if (a.viewWidth.mantissa != b.viewWidth.mantissa || a.viewWidth.exponent != b.viewWidth.exponent ||
+        a.viewHeight.mantissa != b.viewHeight.mantissa || a.viewHeight.exponent != b.viewHeight.exponent) {
+        return false;
+    }
+    if (a.width != b.width || a.height != b.height || a.kernel != b.kernel || a.backend != b.backend ||
+        a.precision != b.precision || a.subdivide != b.subdivide || a.samples != b.samples || a.formula != b.formula || a.distance != b.distance) {
+        return false;
+    }
+    if (a.formula == FORMULA_JULIA && (a.juliaX != b.juliaX || a.juliaY != b.juliaY)) {
+        return false;
+    }
+    // The perturbation settings change the bignum results slightly, so they must match there
+    return a.precision != PRECISION_BIGNUM || (a.perturbation == b.perturbation && a.series == b.series);
+}
+
+bool sameGrid(const ViewSnapshot& a, const ViewSnapshot& b) {
+    return a.maxIter == b.maxIter && sameCoordinates(a, b);
+}
+
+// True if the frame cache holds exactly this view's pixels
+bool frameInCache(const ViewSnapshot& view) {
+    return std::any_of(frameCache.begin(), frameCache.end(), [&](const CachedFrame& frame) {
+        return sameGrid(frame.view, view) && frame.view.panX == view.panX && frame.view.panY == view.panY;
+        });
+}
+
+// Copies the pixels the best cached frame shares with `view` into the buffers and returns where
+// they landed (empty if no cached frame overlaps)
+PixelRect reuseCachedPixels(const ViewSnapshot& view) {
+    PixelRect best;
+    const CachedFrame* source = nullptr;
+    for (CachedFrame& frame : frameCache) {
+        if (!sameGrid(frame.view, view)) {
+            continue;
+        }
+        // Pixel (px, py) of the view is pixel (px + dx, py + dy) of the cached frame
+        const long long dx = view.panX - frame.view.panX;
+        const long long dy = view.panY - frame.view.panY;
+        PixelRect overlap;
+        overlap.x0 = static_cast<int>(std::max(0LL, -dx));
+        overlap.x1 = static_cast<int>(std::max(0LL, std::min<long long>(view.width, view.width - dx)));
+        overlap.y0 = static_cast<int>(std::max(0LL, -dy));
+        overlap.y1 = static_cast<int>(std::max(0LL, std::min<long long>(view.height, view.height - dy)));
+        const long long area = static_cast<long long>(std::max(0, overlap.x1 - overlap.x0)) * std::max(0, overlap.y1 - overlap.y0);
+        if (area > static_cast<long long>(best.x1 - best.x0) * (best.y1 - best.y0)) {
+            best = overlap;
+            source = &frame;
+        }
+    }
+    if (!source) {
+        return PixelRect();
+    }
+
+    const int dx = static_cast<int>(view.panX - source->view.panX);
+    const int dy = static_cast<int>(view.panY - source->view.panY);
+    const_cast<CachedFrame*>(source)->lastUse = ++frameCacheClock;
+    renderPool->parallelFor(best.y1 - best.y0, [&](int row) {
+        const int py = best.y0 + row;
+        const int from = (py + dy) * bufferStride + best.x0 + dx;
+        std::copy(source->iterations.begin() + from, source->iterations.begin() + from + (best.x1 - best.x0), iterationBuffer.begin() + py * bufferStride + best.x0);
+        std::copy(source->fractions.begin() + from, source->fractions.begin() + from + (best.x1 - best.x0), smoothBuffer.begin() + py * bufferStride + best.x0);
+        });
+    return best;
+}
+
+// Stores the finished buffers, replacing the least recently used frame once the cache is full
+void cacheFrame(const ViewSnapshot& view) {
+    CachedFrame* slot = nullptr;
+    if (frameCache.size() < FRAME_CACHE_SIZE) {
+        frameCache.emplace_back();
+        slot = &frameCache.back();
+    }
+    else {
+        slot = &*std::min_element(frameCache.begin(), frameCache.end(),
+            [](const CachedFrame& a, const CachedFrame& b) { return a.lastUse < b.lastUse; });
+    }
+    slot->view = view;
+    slot->iterations = iterationBuffer;
+    slot->fractions = smoothBuffer;
+    slot->lastUse = ++frameCacheClock;
+}
+
+// A pixel that ran out of iterations: its offset in the buffers and where its orbit stopped
+struct PendingPixel {
+    int index;
+    OrbitState state;
+};
+
+// Unfinished pixels of the last frame computed in full, so that raising the iteration limit on
+// the same view continues only those. Only the render thread touches it.
+struct ResumableFrame {
+    ViewSnapshot view;
+    std::vector<PendingPixel> pixels;
+    int seriesSkip = 0; // Perturbation deltas were started from the series at this iteration
+    bool valid = false;
+};
+
+ResumableFrame resumableFrame;
+
+// Reallocates the buffers for a frame of a new size, which leaves nothing to resume. The pool
+// clears the new buffers row by row: pages are placed on the NUMA node of the thread that first
+// writes them, which for most rows is the worker that later computes them.
+void sizeBuffers(int width, int height) {
+    if (width != bufferWidth || height != bufferHeight) {
+        bufferWidth = width;
+        bufferHeight = height;
+        bufferStride = (width + 15) & ~15;
+        AlignedVector<int>(bufferStride * height).swap(iterationBuffer);
+        AlignedVector<float>(bufferStride * height).swap(smoothBuffer);
+        renderPool->parallelFor(height, [](int py) {
+            std::fill_n(&iterationBuffer[py * bufferStride], bufferStride, 0);
+            std::fill_n(&smoothBuffer[py * bufferStride], bufferStride, 0.0f);
+            });
+        resumableFrame.valid = false;
+    }
+}
+
+// Pseudorandom offset in [0, 1) of a sample within its stratum. Sample positions hash a pixel's
+// place relative to the view center, twice its offset in pixels, so panned frames, still bands
+// and farm strips all sample a point at the same spot.
+inline double sampleJitter(long long position, int stratum, int axis) {
+    uint64_t h = static_cast<uint64_t>(position) * 0x9E3779B97F4A7C15ull + static_cast<uint64_t>(2 * stratum + axis + 1) * 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 31;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 29;
+    return static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Fills iterationBuffer and smoothBuffer for the view. With progressive rendering the frame is
+// sampled every 8th, 4th, 2nd and finally every pixel; each pass computes only the pixels
+// earlier passes skipped, and onPass() runs after each one with the buffers complete. Pixels a
+// cached frame already has are copied instead of computed, and raising the limit on the last
+// view continues its unfinished pixels in a single pass. Each call starts a scratch frame.
+// Returns false if cancelled() turned true first, leaving the buffers partly updated.
+template <typename CancelCheck, typename PassCallback>
+bool computeIterations(const ViewSnapshot& view, CancelCheck cancelled, PassCallback onPass) {
+    beginScratchFrame();
+    const int width = view.width;
+    const int height = view.height;
+    const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    const int kernelLevel = view.kernel;
+    const int dynamicMaxIter = view.maxIter;
+    const FloatExp pixelSpacing = std::min(view.viewWidth * (1.0 / width), view.viewHeight * (1.0 / height));
+    const int precision = view.precision;
+    const int bigPrecision = bigFloatPrecisionFor(pixelSpacing);
+    const float logPower = std::log2(static_cast<float>(formulaPowers[view.formula]));
+
+    const bool profiling = useProfiling.load();
+    const auto orbitStart = std::chrono::steady_clock::now();
+
+    // Past double-double, iterate deltas against one reference orbit at the (unpanned) center.
+    // Distance mode has no bignum kernel of its own, so it always takes the orbit.
+    std::shared_ptr<const ReferenceOrbit> orbit;
+    if (precision == PRECISION_BIGNUM && (view.perturbation || view.distance)) {
+        orbit = getReferenceOrbit(view.centerX, view.centerY, bigPrecision, dynamicMaxIter);
+    }
+    const bool floatExpDeltas = pixelSpacing.exponent < FLOATEXP_SPACING_EXPONENT;
+
+    SeriesApproximation series;
+    if (orbit && view.series && !view.distance) {
+        // The series must hold out to the far edge of a panned view
+        const FloatExp halfWidth = view.viewWidth * (0.5 + std::abs(static_cast<double>(view.panX)) / width);
+        const FloatExp halfHeight = view.viewHeight * (0.5 + std::abs(static_cast<double>(view.panY)) / height);
+        series = computeSeriesApproximation(*orbit, halfWidth, halfHeight, dynamicMaxIter);
+    }
+    if (profiling) {
+        currentProfile.orbitMs = millisecondsSince(orbitStart);
+    }
+
+    // Every pixel's c is (column x, row y), so the coordinates are computed once per column and
+    // once per row for the frame in whichever form the chosen precision needs. Per-pixel offsets
+    // from the center only need a double mantissa, at any depth. With `scale` above 1 the tables
+    // hold the jittered sample strata instead, `scale` per pixel column and per pixel row, and
+    // with a `margin` they start that many pixels outside the frame.
+    ScratchVector<FloatExp> offsetX, offsetY;
+    ScratchVector<double> columnX, rowY, columnU, rowU;
+    ScratchVector<DoubleDouble> columnXdd, rowYdd;
+    ScratchVector<BigFloat> columnXbig, rowYbig;
+    auto buildCoordinates = [&](int scale, int margin) {
+        const int columns = (width + 2 * margin) * scale, rows = (height + 2 * margin) * scale;
+        offsetX.resize(columns);
+        offsetY.resize(rows);
+        for (int k = 0; k < columns; ++k) {
+            const int px = k / scale - margin;
+            const double subpixel = scale > 1 ? (k % scale + sampleJitter(2 * (px + view.panX) - width, k % scale, 0)) / scale : 0.0;
+            offsetX[k] = view.viewWidth * ((static_cast<double>(px + view.panX) + subpixel) / width - 0.5);
+        }
+        for (int k = 0; k < rows; ++k) {
+            const int py = k / scale - margin;
+            const double subpixel = scale > 1 ? (k % scale + sampleJitter(2 * (py + view.panY) - height, k % scale, 1)) / scale : 0.0;
+            offsetY[k] = view.viewHeight * ((static_cast<double>(py + view.panY) + subpixel) / height - 0.5);
+        }
+
+        columnX.clear();
+        rowY.clear();
+        columnU.clear();
+        rowU.clear();
+        columnXdd.clear();
+        rowYdd.clear();
+        columnXbig.clear();
+        rowYbig.clear();
+        switch (precision) {
+        case PRECISION_FLOAT:
+        case PRECISION_DOUBLE: {
+            columnX.reserve(columns);
+            rowY.reserve(rows);
+            const double centerXd = view.centerX.toDouble();
+            const double centerYd = view.centerY.toDouble();
+            for (int px = 0; px < columns; ++px) {
+                columnX.push_back(centerXd + offsetX[px].toDouble());
+            }
+            for (int py = 0; py < rows; ++py) {
+                rowY.push_back(centerYd + offsetY[py].toDouble());
+            }
+            break;
+        }
+        case PRECISION_DOUBLEDOUBLE: {
+            columnXdd.reserve(columns);
+            rowYdd.reserve(rows);
+            const DoubleDouble centerXdd = view.centerX.toDoubleDouble();
+            const DoubleDouble centerYdd = view.centerY.toDoubleDouble();
+            for (int px = 0; px < columns; ++px) {
+                columnXdd.push_back(centerXdd + DoubleDouble{ offsetX[px].toDouble(), 0.0 });
+            }
+            for (int py = 0; py < rows; ++py) {
+                rowYdd.push_back(centerYdd + DoubleDouble{ offsetY[py].toDouble(), 0.0 });
+            }
+            break;
+        }
+        default:
+            if (orbit) {
+                // Perturbation works on the offsets themselves, plus their position within the series radius
+                columnX.reserve(columns);
+                rowY.reserve(rows);
+                columnU.reserve(columns);
+                rowU.reserve(rows);
+                for (int px = 0; px < columns; ++px) {
+                    columnX.push_back(offsetX[px].toDouble());
+                    columnU.push_back(series.relative(offsetX[px]));
+                }
+                for (int py = 0; py < rows; ++py) {
+                    rowY.push_back(offsetY[py].toDouble());
+                    rowU.push_back(series.relative(offsetY[py]));
+                }
+            }
+            else {
+                const BigFloat centerXbig = view.centerX.withPrecision(bigPrecision);
+                const BigFloat centerYbig = view.centerY.withPrecision(bigPrecision);
+                columnXbig.reserve(columns);
+                rowYbig.reserve(rows);
+                for (int px = 0; px < columns; ++px) {
+                    columnXbig.push_back(centerXbig + BigFloat(offsetX[px], bigPrecision));
+                }
+                for (int py = 0; py < rows; ++py) {
+                    rowYbig.push_back(centerYbig + BigFloat(offsetY[py], bigPrecision));
+                }
+            }
+            break;
+        }
+        };
+    buildCoordinates(1, 0);
+
+    PixelRect reused;
+
+    // Frames computed in full by the brute-force path keep their unfinished pixels for resuming;
+    // the BigFloat and FloatExp paths and the GPU do not carry their state over
+    const bool resumable = !usesGpu(view) && view.samples <= 1 && (precision != PRECISION_BIGNUM || (orbit && !floatExpDeltas));
+
+    // Runs the kernel for the precision on the pixels (columns[i], rows[i]). With resumeIter 0
+    // they start from scratch; otherwise they continue from states[i] at iteration resumeIter.
+    auto runKernel = [&](const int* columns, const int* rows, int count, int resumeIter, OrbitState* states, int* iterations, float* magnitudes) {
+        double cx[TILE_SIZE], cy[TILE_SIZE];
+        DoubleDouble cxdd[TILE_SIZE], cydd[TILE_SIZE];
+
+        switch (precision) {
+        case PRECISION_FLOAT:
+        case PRECISION_DOUBLE:
+            for (int i = 0; i < count; ++i) {
+                cx[i] = columnX[columns[i]];
+                cy[i] = rowY[rows[i]];
+            }
+            if (view.formula != FORMULA_MANDELBROT) {
+                (precision == PRECISION_FLOAT ? floatFormulaKernelTable : formulaKernelTable)[view.formula][kernelLevel](cx, cy, view.juliaX, view.juliaY,
+                    count, resumeIter, dynamicMaxIter, iterations, magnitudes, states);
+            }
+            else {
+                (precision == PRECISION_FLOAT ? floatKernelTable : kernelTable)[kernelLevel](cx, cy, count, resumeIter, dynamicMaxIter, iterations, magnitudes, states);
+            }
+            break;
+        case PRECISION_DOUBLEDOUBLE:
+            for (int i = 0; i < count; ++i) {
+                cxdd[i] = columnXdd[columns[i]];
+                cydd[i] = rowYdd[rows[i]];
+            }
+            if (view.formula != FORMULA_MANDELBROT) {
+                doubleDoubleFormulaTable[view.formula](cxdd, cydd, DoubleDouble{ view.juliaX, 0.0 }, DoubleDouble{ view.juliaY, 0.0 },
+                    count, resumeIter, dynamicMaxIter, iterations, magnitudes, states);
+            }
+            else {
+                doubleDoubleKernelTable[kernelLevel](cxdd, cydd, count, resumeIter, dynamicMaxIter, iterations, magnitudes, states);
+            }
+            break;
+        default:
+            if (orbit && !floatExpDeltas) {
+                for (int i = 0; i < count; ++i) {
+                    cx[i] = columnX[columns[i]];
+                    cy[i] = rowY[rows[i]];
+                    if (resumeIter == 0) {
+                        series.evaluate(columnU[columns[i]], rowU[rows[i]], states[i].zr, states[i].zi);
+                        states[i].zr = std::ldexp(states[i].zr, series.exponent);
+                        states[i].zi = std::ldexp(states[i].zi, series.exponent);
+                        states[i].reference = series.skip;
+                    }
+                }
+                perturbationKernelTable[kernelLevel](*orbit, cx, cy, resumeIter == 0 ? series.skip : resumeIter, count, dynamicMaxIter, iterations, magnitudes, states);
+            }
+            else if (orbit) {
+                for (int i = 0; i < count; ++i) {
+                    double sr, si;
+                    series.evaluate(columnU[columns[i]], rowU[rows[i]], sr, si);
+                    iterations[i] = perturbFloatExp(*orbit, offsetX[columns[i]], offsetY[rows[i]],
+                        FloatExp(sr, series.exponent), FloatExp(si, series.exponent), series.skip, dynamicMaxIter, magnitudes[i]);
+                }
+            }
+            else if (view.formula != FORMULA_MANDELBROT) {
+                const BigFloat juliaXbig(view.juliaX, bigPrecision);
+                const BigFloat juliaYbig(view.juliaY, bigPrecision);
+                for (int i = 0; i < count; ++i) {
+                    iterations[i] = bigFloatFormulaTable[view.formula](columnXbig[columns[i]], rowYbig[rows[i]], juliaXbig, juliaYbig, dynamicMaxIter, magnitudes[i]);
+                }
+            }
+            else {
+                for (int i = 0; i < count; ++i) {
+                    iterations[i] = escapeBigFloat(columnXbig[columns[i]], rowYbig[rows[i]], dynamicMaxIter, magnitudes[i]);
+                }
+            }
+            break;
+        }
+
+        if (profiling) {
+            const int start = resumeIter == 0 && orbit ? series.skip : resumeIter;
+            long long executed = 0;
+            for (int i = 0; i < count; ++i) {
+                executed += std::max(iterations[i] - start, 0);
+            }
+            frameIterations += executed;
+        }
+        };
+
+    // Writes kernel results to the buffers and, given `pending`, keeps the state of pixels that
+    // ran out of iterations
+    auto storePixels = [&](const int* columns, const int* rows, int count, const int* iterations, const float* magnitudes,
+        const OrbitState* states, ScratchVector<PendingPixel>* pending) {
+        for (int i = 0; i < count; ++i) {
+            const int index = rows[i] * bufferStride + columns[i];
+            iterationBuffer[index] = iterations[i];
+            smoothBuffer[index] = iterations[i] < dynamicMaxIter ? smoothFraction(magnitudes[i], logPower) : 0.0f;
+            if (pending && resumable && iterations[i] == dynamicMaxIter && !states[i].settled) {
+                pending->push_back({ index, states[i] });
+            }
+        }
+        };
+
+    // Distance mode runs the distance kernels instead, which write each pixel's estimate in
+    // pixels. FloatExp depths have none: there escaped pixels simply take the background shade.
+    const double pixelsPerUnit = 1.0 / pixelSpacing.toDouble();
+    auto runDistanceKernel = [&](const int* columns, const int* rows, int count, int* iterations, float* distances) {
+        double cx[DISTANCE_BATCH], cy[DISTANCE_BATCH];
+        DoubleDouble cxdd[DISTANCE_BATCH], cydd[DISTANCE_BATCH];
+
+        for (int i = 0; i < count; ++i) {
+            if (precision == PRECISION_DOUBLEDOUBLE) {
+                cxdd[i] = columnXdd[columns[i]];
+                cydd[i] = rowYdd[rows[i]];
+            }
+            else {
+                cx[i] = columnX[columns[i]];
+                cy[i] = rowY[rows[i]];
+            }
+        }
+        if (precision == PRECISION_DOUBLEDOUBLE) {
+            estimateDistanceScalar(cxdd, cydd, count, dynamicMaxIter, pixelsPerUnit, iterations, distances);
+        }
+        else if (precision != PRECISION_BIGNUM) {
+            distanceKernelTable[kernelLevel](cx, cy, count, dynamicMaxIter, pixelsPerUnit, iterations, distances);
+        }
+        else if (!floatExpDeltas) {
+            perturbDistance(*orbit, cx, cy, count, dynamicMaxIter, pixelsPerUnit, iterations, distances);
+        }
+        else {
+            float magnitudes[DISTANCE_BATCH];
+            OrbitState states[DISTANCE_BATCH];
+            runKernel(columns, rows, count, 0, states, iterations, magnitudes);
+            std::fill(distances, distances + count, DISTANCE_EDGE);
+            return;
+        }
+
+        if (profiling) {
+            frameIterations += std::accumulate(iterations, iterations + count, 0LL);
+        }
+        };
+
+    // Walks each tile row by row, so kernels read contiguous runs of columns and write contiguous
+    // runs of the row-major buffers. A pass with a larger step takes every step-th row and column.
+    // When refining, rows the previous pass sampled only need the columns between its samples.
+    auto drawRegion = [&](int startCol, int endCol, int startRow, int endRow, int step, bool refining, ScratchVector<PendingPixel>& pending) {
+        int columns[TILE_SIZE], rows[TILE_SIZE], iterations[TILE_SIZE];
+        float magnitudes[TILE_SIZE];
+        OrbitState states[TILE_SIZE];
+
+        for (int py = startRow; py < endRow && !cancelled(); py += step) {
+            const bool sampledRow = refining && py % (2 * step) == 0;
+            const bool reusedRow = py >= reused.y0 && py < reused.y1;
+            int count = 0;
+            for (int px = startCol + (sampledRow ? step : 0); px < endCol; px += sampledRow ? 2 * step : step) {
+                if (!reusedRow || px < reused.x0 || px >= reused.x1) {
+                    columns[count++] = px;
+                }
+            }
+            std::fill(rows, rows + count, py);
+
+            runKernel(columns, rows, count, 0, states, iterations, magnitudes);
+            storePixels(columns, rows, count, iterations, magnitudes, states, &pending);
+        }
+        };
+
+    // Adaptive anti-aliasing over the finished frame. Pixels whose continuous count differs from
+    // a neighbour's by more than ANTIALIAS_THRESHOLD, or that border the set, get the other samples
+    // of their jittered strata. A pixel's samples combine into its count and fraction before
+    // coloring: the set if most of them are in it, otherwise the mean continuous count of the
+    // escaped ones. Pixels from the cache were refined with their frame.
+    auto refineSamples = [&]() {
+        if (view.samples <= 1) {
+            return true;
+        }
+        const int scale = view.samples >= 16 ? 4 : 2;
+        const int extra = scale * scale - 1; // The pixel's own sample stands in for the first stratum
+
+        // The rows and columns just outside the frame, so edge pixels are judged as inside a larger
+        // frame and still bands and farm strips show no seams. In order: top, bottom, left, right.
+        const int haloCount = 2 * (width + height);
+        ScratchVector<int> haloIterations(haloCount);
+        ScratchVector<float> haloFractions(haloCount);
+        auto haloIndex = [&](int x, int y) {
+            return y < 0 ? x : y == height ? width + x : x < 0 ? 2 * width + y : 2 * width + height + y;
+            };
+        buildCoordinates(1, 1);
+        renderPool->parallelFor((haloCount + TILE_SIZE - 1) / TILE_SIZE, [&](int chunk) {
+            int columns[TILE_SIZE], rows[TILE_SIZE], iterations[TILE_SIZE];
+            float magnitudes[TILE_SIZE];
+            OrbitState states[TILE_SIZE];
+            const int first = chunk * TILE_SIZE;
+            const int count = std::min(TILE_SIZE, haloCount - first);
+            for (int i = 0; i < count; ++i) {
+                const int h = first + i;
+                const int x = h < width ? h : h < 2 * width ? h - width : h < 2 * width + height ? -1 : width;
+                const int y = h < width ? -1 : h < 2 * width ? height : h < 2 * width + height ? h - 2 * width : h - 2 * width - height;
+                columns[i] = x + 1;
+                rows[i] = y + 1;
+            }
+            runKernel(columns, rows, count, 0, states, iterations, magnitudes);
+            for (int i = 0; i < count; ++i) {
+                haloIterations[first + i] = iterations[i];
+                haloFractions[first + i] = iterations[i] < dynamicMaxIter ? smoothFraction(magnitudes[i], logPower) : 0.0f;
+            }
+            });
+
+        // Continuous count of a pixel, or -1 in the set
+        auto value = [&](int x, int y) {
+            int n;
+            float fraction;
+            if (x >= 0 && x < width && y >= 0 && y < height) {
+                n = iterationBuffer[y * bufferStride + x];
+                fraction = smoothBuffer[y * bufferStride + x];
+            }
+            else {
+                n = haloIterations[haloIndex(x, y)];
+                fraction = haloFractions[haloIndex(x, y)];
+            }
+            return n == dynamicMaxIter ? -1.0 : n + fraction;
+            };
+        auto differs = [](double a, double b) {
+            return (a < 0) != (b < 0) || (a >= 0 && std::fabs(a - b) > ANTIALIAS_THRESHOLD);
+            };
+        ScratchVector<unsigned char> refine(bufferStride * height, 0);
+        renderPool->parallelFor(height, [&](int py) {
+            for (int px = 0; px < width; ++px) {
+                const double center = value(px, py);
+                refine[py * bufferStride + px] = !reused.contains(px, py) &&
+                    (differs(center, value(px - 1, py)) || differs(center, value(px + 1, py)) ||
+                        differs(center, value(px, py - 1)) || differs(center, value(px, py + 1)));
+            }
+            });
+        if (cancelled()) {
+            return false;
+        }
+
+        buildCoordinates(scale, 0);
+        renderPool->parallelFor(height, [&](int py) {
+            int columns[TILE_SIZE], rows[TILE_SIZE], iterations[TILE_SIZE], pixels[TILE_SIZE];
+            float magnitudes[TILE_SIZE];
+            OrbitState states[TILE_SIZE];
+            int pixelCount = 0, count = 0;
+
+            auto combine = [&]() {
+                runKernel(columns, rows, count, 0, states, iterations, magnitudes);
+                for (int p = 0; p < pixelCount; ++p) {
+                    const int index = py * bufferStride + pixels[p];
+                    int inside = 0, escaped = 0;
+                    double sum = 0.0;
+                    auto add = [&](int n, float fraction) {
+                        if (n == dynamicMaxIter) {
+                            ++inside;
+                        }
+                        else {
+                            ++escaped;
+                            sum += n + fraction;
+                        }
+                        };
+                    add(iterationBuffer[index], smoothBuffer[index]);
+                    for (int i = p * extra; i < (p + 1) * extra; ++i) {
+                        add(iterations[i], iterations[i] < dynamicMaxIter ? smoothFraction(magnitudes[i], logPower) : 0.0f);
+                    }
+
+                    if (2 * inside > inside + escaped) {
+                        iterationBuffer[index] = dynamicMaxIter;
+                        smoothBuffer[index] = 0.0f;
+                    }
+                    else {
+                        const double mean = sum / escaped;
+                        iterationBuffer[index] = std::min(static_cast<int>(mean), dynamicMaxIter - 1);
+                        smoothBuffer[index] = std::min(static_cast<float>(mean - iterationBuffer[index]), 1.0f);
+                    }
+                }
+                pixelCount = 0;
+                count = 0;
+                };
+
+            for (int px = 0; px < width && !cancelled(); ++px) {
+                if (!refine[py * bufferStride + px]) {
+                    continue;
+                }
+                if (count + extra > TILE_SIZE) {
+                    combine();
+                }
+                pixels[pixelCount++] = px;
+                for (int stratum = 1; stratum <= extra; ++stratum) {
+                    columns[count] = px * scale + stratum % scale;
+                    rows[count++] = py * scale + stratum / scale;
+                }
+            }
+            if (count > 0) {
+                combine();
+            }
+            });
+
+        if (cancelled()) {
+            return false;
+        }
+        onPass();
+        return true;
+        };
+
+    sizeBuffers(width, height);
+    bufferMaxIter = dynamicMaxIter;
+
+    // Raising the limit on an unchanged view only continues the pixels that ran out last time.
+    // The others escaped, or were proven interior and only need their count moved to the new limit.
+    // A series that now skips further than before starts pixels closer to the end, and differently,
+    // so then the frame is computed afresh.
+    const ViewSnapshot& last = resumableFrame.view;
+    if (resumableFrame.valid && resumable && dynamicMaxIter > last.maxIter && series.skip == resumableFrame.seriesSkip &&
+        last.panX == view.panX && last.panY == view.panY && sameCoordinates(last, view)) {
+        const int previousMaxIter = last.maxIter;
+        resumableFrame.valid = false;
+        ++cacheCounters.resumes;
+        // Copied out, so the list keeps its capacity for the pixels still unfinished afterwards
+        const ScratchVector<PendingPixel> pixels(resumableFrame.pixels.begin(), resumableFrame.pixels.end());
+        resumableFrame.pixels.clear();
+
+        renderPool->parallelFor(height, [&](int py) {
+            int* row = &iterationBuffer[py * bufferStride];
+            std::replace(row, row + width, previousMaxIter, dynamicMaxIter);
+            });
+
+        const int chunkSize = TILE_SIZE * TILE_SIZE;
+        const int chunks = static_cast<int>((pixels.size() + chunkSize - 1) / chunkSize);
+        ScratchVector<ScratchVector<PendingPixel>> chunkPending(chunks);
+        renderPool->parallelFor(chunks, [&](int chunk) {
+            int columns[TILE_SIZE], rows[TILE_SIZE], iterations[TILE_SIZE];
+            float magnitudes[TILE_SIZE];
+            OrbitState states[TILE_SIZE];
+
+            const int end = std::min(static_cast<int>(pixels.size()), (chunk + 1) * chunkSize);
+            for (int first = chunk * chunkSize; first < end && !cancelled(); first += TILE_SIZE) {
+                const int count = std::min(TILE_SIZE, end - first);
+                for (int i = 0; i < count; ++i) {
+                    columns[i] = pixels[first + i].index % bufferStride;
+                    rows[i] = pixels[first + i].index / bufferStride;
+                    states[i] = pixels[first + i].state;
+                }
+                runKernel(columns, rows, count, previousMaxIter, states, iterations, magnitudes);
+                storePixels(columns, rows, count, iterations, magnitudes, states, &chunkPending[chunk]);
+            }
+            });
+
+        if (cancelled()) {
+            return false;
+        }
+        for (const ScratchVector<PendingPixel>& pending : chunkPending) {
+            resumableFrame.pixels.insert(resumableFrame.pixels.end(), pending.begin(), pending.end());
+        }
+        resumableFrame.view = view;
+        resumableFrame.seriesSkip = series.skip;
+        resumableFrame.valid = true;
+        onPass();
+        cacheFrame(view);
+        return true;
+    }
+    resumableFrame.valid = false;
+
+    reused = reuseCachedPixels(view);
+    cacheCounters.framePixels += static_cast<long long>(width) * height;
+    cacheCounters.reusedPixels += static_cast<long long>(reused.x1 - reused.x0) * (reused.y1 - reused.y0);
+    if (reused.x0 == 0 && reused.y0 == 0 && reused.x1 == width && reused.y1 == height) {
+        onPass();
+        return true;
+    }
+
+    // The GPU computes the whole frame in one pass, reused pixels included
+    if (usesGpu(view)) {
+        const GpuBackend::Result result = gpuBackend().compute(precision, columnX, rowY, columnXdd, rowYdd, width, height,
+            dynamicMaxIter, iterationBuffer.data(), smoothBuffer.data(), bufferStride, cancelled);
+        if (result == GpuBackend::CANCELLED) {
+            return false;
+        }
+        if (result == GpuBackend::DONE) {
+            if (profiling) {
+                long long executed = 0;
+                for (int py = 0; py < height; ++py) {
+                    executed += std::accumulate(&iterationBuffer[py * bufferStride], &iterationBuffer[py * bufferStride] + width, 0LL);
+                }
+                frameIterations += executed;
+            }
+            onPass();
+            if (!refineSamples()) {
+                return false;
+            }
+            cacheFrame(view);
+            return true;
+        }
+        // A failed device leaves this frame to the CPU below
+    }
+
+    // Distance mode samples the frame coarse to fine in the order of the progressive passes, and
+    // every escaped pixel also settles the pixels around it: a point within b / 4 - DISTANCE_EDGE
+    // pixels of it lies at least DISTANCE_EDGE pixels from the set, so its own estimate could
+    // only give the background shade, and it takes that without iterating. Its count is the
+    // pixel's, a stand-in that only the escape statistics see. Fills stay inside their tile, so
+    // the tiles of a pass run in parallel, and nothing is kept for resuming.
+    if (view.distance) {
+        ScratchVector<unsigned char> known(bufferStride * height, 0);
+        for (int py = reused.y0; py < reused.y1; ++py) {
+            std::fill(&known[py * bufferStride + reused.x0], &known[py * bufferStride + reused.x1], 1);
+        }
+
+        auto drawDistanceTile = [&](int startCol, int endCol, int startRow, int endRow, int step) {
+            int columns[DISTANCE_BATCH], rows[DISTANCE_BATCH], iterations[DISTANCE_BATCH];
+            float distances[DISTANCE_BATCH];
+            int count = 0;
+
+            auto flush = [&]() {
+                runDistanceKernel(columns, rows, count, iterations, distances);
+                for (int i = 0; i < count; ++i) {
+                    const bool escaped = iterations[i] < dynamicMaxIter;
+                    iterationBuffer[rows[i] * bufferStride + columns[i]] = iterations[i];
+                    smoothBuffer[rows[i] * bufferStride + columns[i]] = escaped ? distanceShade(distances[i]) : 0.0f;
+
+                    const double radius = distances[i] / 4.0 - DISTANCE_EDGE;
+                    if (!escaped || radius < 1.0) {
+                        continue;
+                    }
+                    const int reach = static_cast<int>(radius);
+                    for (int py = std::max(startRow, rows[i] - reach); py <= std::min(endRow - 1, rows[i] + reach); ++py) {
+                        const int dy = py - rows[i];
+                        const int halfChord = static_cast<int>(std::sqrt(radius * radius - dy * dy));
+                        for (int px = std::max(startCol, columns[i] - halfChord); px <= std::min(endCol - 1, columns[i] + halfChord); ++px) {
+                            const int index = py * bufferStride + px;
+                            if (!known[index]) {
+                                known[index] = 1;
+                                iterationBuffer[index] = iterations[i];
+                                smoothBuffer[index] = 1.0f;
+                            }
+                        }
+                    }
+                }
+                count = 0;
+                };
+
+            for (int py = startRow; py < endRow && !cancelled(); py += step) {
+                for (int px = startCol; px < endCol; px += step) {
+                    const int index = py * bufferStride + px;
+                    if (known[index]) {
+                        continue;
+                    }
+                    known[index] = 1;
+                    columns[count] = px;
+                    rows[count++] = py;
+                    if (count == DISTANCE_BATCH) {
+                        flush();
+                    }
+                }
+            }
+            if (count > 0) {
+                flush();
+            }
+            };
+
+        for (int step = PREVIEW_STEP; step >= 1; step /= 2) {
+            renderPool->parallelFor(tilesX * tilesY, [&](int tile) {
+                int startCol = (tile % tilesX) * TILE_SIZE;
+                int startRow = (tile / tilesX) * TILE_SIZE;
+                drawDistanceTile(startCol, std::min(startCol + TILE_SIZE, width), startRow, std::min(startRow + TILE_SIZE, height), step);
+                });
+
+            if (cancelled()) {
+                return false;
+            }
+            if (step > 1 && view.progressive) {
+                fillPreview(step, reused, known.data());
+                onPass();
+            }
+        }
+        onPass();
+        cacheFrame(view);
+        return true;
+    }
+
+    // Mariani-Silver subdivision: a rectangle whose whole border has one iteration count is
+    // filled with it, any other is split in four by a cross through its middle. Every rectangle of
+    // a level of the subdivision tree already has its border computed, so a level is one parallel
+    // pass over its rectangles, each computing only its own cross. Neighbours share their edges.
+    if (view.subdivide && width > 2 && height > 2) {
+        ScratchVector<unsigned char> known(bufferStride * height, 0);
+        for (int py = reused.y0; py < reused.y1; ++py) {
+            std::fill(&known[py * bufferStride + reused.x0], &known[py * bufferStride + reused.x1], 1);
+        }
+
+        // Pixels gathered for one kernel call, so the short and scattered runs of a task, such as
+        // the grid columns of a row or both arms of a cross, share their calls
+        struct PixelBatch {
+            int columns[TILE_SIZE], rows[TILE_SIZE];
+            int count = 0;
+        };
+        auto flushBatch = [&](PixelBatch& batch) {
+            if (batch.count == 0) {
+                return;
+            }
+            int iterations[TILE_SIZE];
+            float magnitudes[TILE_SIZE];
+            OrbitState states[TILE_SIZE];
+            runKernel(batch.columns, batch.rows, batch.count, 0, states, iterations, magnitudes);
+            storePixels(batch.columns, batch.rows, batch.count, iterations, magnitudes, states, nullptr);
+            batch.count = 0;
+            };
+
+        // Adds the pixels of a horizontal or vertical run that are not known yet to the batch,
+        // computing it whenever it fills; a task flushes its batch before it returns
+        auto computeRun = [&](PixelBatch& batch, int x, int y, int dx, int dy, int length) {
+            for (int i = 0; i < length; ++i) {
+                unsigned char& done = known[(y + i * dy) * bufferStride + x + i * dx];
+                if (done) {
+                    continue;
+                }
+                done = 1;
+                batch.columns[batch.count] = x + i * dx;
+                batch.rows[batch.count++] = y + i * dy;
+                if (batch.count == TILE_SIZE) {
+                    flushBatch(batch);
+                }
+            }
+            };
+
+        // The top level is the tile grid; rows and columns on grid lines are computed first
+        auto gridLine = [](int p, int size) { return p % TILE_SIZE == 0 || p == size - 1; };
+        renderPool->parallelFor(height, [&](int py) {
+            PixelBatch batch;
+            if (gridLine(py, height)) {
+                computeRun(batch, 0, py, 1, 0, width);
+            }
+            else {
+                for (int px = 0; px < width; px += TILE_SIZE) {
+                    computeRun(batch, px, py, 1, 0, 1);
+                }
+                computeRun(batch, width - 1, py, 1, 0, 1);
+            }
+            flushBatch(batch);
+            });
+
+        ScratchVector<PixelRect> level;
+        for (int y0 = 0; y0 < height - 1; y0 += TILE_SIZE) {
+            for (int x0 = 0; x0 < width - 1; x0 += TILE_SIZE) {
+                PixelRect rect;
+                rect.x0 = x0;
+                rect.y0 = y0;
+                rect.x1 = std::min(x0 + TILE_SIZE, width - 1) + 1;
+                rect.y1 = std::min(y0 + TILE_SIZE, height - 1) + 1;
+                level.push_back(rect);
+            }
+        }
+
+        while (!level.empty()) {
+            ScratchVector<ScratchVector<PixelRect>> children(level.size());
+            renderPool->parallelFor(static_cast<int>(level.size()), [&](int r) {
+                if (cancelled()) {
+                    return;
+                }
+                const PixelRect rect = level[r];
+                const int first = iterationBuffer[rect.y0 * bufferStride + rect.x0];
+                bool uniform = true;
+                float fractionSum = 0.0f;
+                int borderCount = 0;
+                auto visit = [&](int px, int py) {
+                    const int index = py * bufferStride + px;
+                    uniform = uniform && iterationBuffer[index] == first;
+                    fractionSum += smoothBuffer[index];
+                    ++borderCount;
+                    };
+                for (int px = rect.x0; px < rect.x1; ++px) {
+                    visit(px, rect.y0);
+                    visit(px, rect.y1 - 1);
+                }
+                for (int py = rect.y0 + 1; py < rect.y1 - 1; ++py) {
+                    visit(rect.x0, py);
+                    visit(rect.x1 - 1, py);
+                }
+
+                if (uniform) {
+                    // Escaped fills take the border's mean fraction, so smooth coloring stays flat
+                    const float fraction = first < dynamicMaxIter ? fractionSum / borderCount : 0.0f;
+                    for (int py = rect.y0 + 1; py < rect.y1 - 1; ++py) {
+                        std::fill(&iterationBuffer[py * bufferStride + rect.x0 + 1], &iterationBuffer[py * bufferStride + rect.x1 - 1], first);
+                        std::fill(&smoothBuffer[py * bufferStride + rect.x0 + 1], &smoothBuffer[py * bufferStride + rect.x1 - 1], fraction);
+                    }
+                }
+                else if (rect.x1 - rect.x0 <= MIN_SUBDIVISION || rect.y1 - rect.y0 <= MIN_SUBDIVISION) {
+                    PixelBatch batch;
+                    for (int py = rect.y0 + 1; py < rect.y1 - 1; ++py) {
+                        computeRun(batch, rect.x0 + 1, py, 1, 0, rect.x1 - rect.x0 - 2);
+                    }
+                    flushBatch(batch);
+                }
+                else {
+                    const int midX = (rect.x0 + rect.x1 - 1) / 2;
+                    const int midY = (rect.y0 + rect.y1 - 1) / 2;
+                    PixelBatch batch;
+                    computeRun(batch, midX, rect.y0 + 1, 0, 1, rect.y1 - rect.y0 - 2);
+                    computeRun(batch, rect.x0 + 1, midY, 1, 0, rect.x1 - rect.x0 - 2);
+                    flushBatch(batch);
+                    PixelRect quarter = rect;
+                    quarter.x1 = midX + 1;
+                    quarter.y1 = midY + 1;
+                    children[r].push_back(quarter);
+                    quarter.x0 = midX;
+                    quarter.x1 = rect.x1;
+                    children[r].push_back(quarter);
+                    quarter.y0 = midY;
+                    quarter.y1 = rect.y1;
+                    children[r].push_back(quarter);
+                    quarter.x0 = rect.x0;
+                    quarter.x1 = midX + 1;
+                    children[r].push_back(quarter);
+                }
+                });
+
+            if (cancelled()) {
+                return false;
+            }
+            level.clear();
+            for (const ScratchVector<PixelRect>& split : children) {
+                level.insert(level.end(), split.begin(), split.end());
+            }
+        }
+
+        // Filled pixels have no orbit state, so a subdivided frame cannot be resumed
+        onPass();
+        if (!refineSamples()) {
+            return false;
+        }
+        cacheFrame(view);
+        return true;
+    }
+
+    // The first passes of a clicked view may be done already; their pixels carry no orbit state
+    ScratchVector<ScratchVector<PendingPixel>> tilePending(tilesX * tilesY);
+    const int firstStep = view.progressive ? PREVIEW_STEP : 1;
+    const bool previewed = view.progressive && clickPreviewValid && reused.x0 == reused.x1 && sameGrid(clickPreview.view, view) &&
+        clickPreview.view.panX == view.panX && clickPreview.view.panY == view.panY;
+    if (previewed) {
+        iterationBuffer = clickPreview.iterations;
+        smoothBuffer = clickPreview.fractions;
+        onPass();
+    }
+    for (int step = previewed ? CLICK_PREVIEW_STEP / 2 : firstStep; step >= 1; step /= 2) {
+        // Split the image into small tiles and let the pool balance them across cores
+        renderPool->parallelFor(tilesX * tilesY, [&](int tile) {
+            int startCol = (tile % tilesX) * TILE_SIZE;
+            int startRow = (tile / tilesX) * TILE_SIZE;
+            drawRegion(startCol, std::min(startCol + TILE_SIZE, width), startRow, std::min(startRow + TILE_SIZE, height), step, step != firstStep, tilePending[tile]);
+            });
+
+        if (cancelled()) {
+            return false;
+        }
+        if (step > 1) {
+            fillPreview(step, reused);
+        }
+        onPass();
+    }
+    if (!refineSamples()) {
+        return false;
+    }
+
+    // Pixels copied from the cache have no state, so only a frame computed in full can resume
+    resumableFrame.pixels.clear();
+    for (const ScratchVector<PendingPixel>& pending : tilePending) {
+        resumableFrame.pixels.insert(resumableFrame.pixels.end(), pending.begin(), pending.end());
+    }
+    resumableFrame.view = view;
+    resumableFrame.seriesSkip = series.skip;
+    resumableFrame.valid = resumable && reused.x0 == reused.x1 && !previewed;
+
+    cacheFrame(view);
+    return true;
+}
+
+// Persistent 32-bit top-down DIB sections. The color pass writes straight into the back
+// buffer's pixels; publishing swaps it to the front, which WM_PAINT blits.
+struct FrameBuffer {
+    HBITMAP bitmap = nullptr;
+    HDC dc = nullptr;
+    COLORREF* pixels = nullptr;
+    int width = 0, height = 0;
+};
+
+std::mutex frameMutex; // Guards frontFrame and the front buffer while it is blitted
+FrameBuffer frameBuffers[2];
+int frontFrame = 0; // Only the render thread changes it, so it reads it without the lock
+
+void destroyFrameBuffer(FrameBuffer& frame) {
+    if (frame.dc) {
+        DeleteDC(frame.dc);
+    }
+    if (frame.bitmap) {
+        DeleteObject(frame.bitmap);
+    }
+    frame = FrameBuffer();
+}
+
+// (Re)creates the DIB section when the frame size changed
+bool ensureFrameBuffer(FrameBuffer& frame, int width, int height) {
+    if (frame.bitmap && frame.width == width && frame.height == height) {
+        return true;
+    }
+    destroyFrameBuffer(frame);
+
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height; // Negative height puts row 0 at the top
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = nullptr;
+    frame.bitmap = CreateDIBSection(nullptr, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (!frame.bitmap || !bits) {
+        destroyFrameBuffer(frame);
+        return false;
+    }
+    frame.dc = CreateCompatibleDC(nullptr);
+    SelectObject(frame.dc, frame.bitmap);
+    frame.pixels = static_cast<COLORREF*>(bits);
+    frame.width = width;
+    frame.height = height;
+    return true;
+}
+
+// Maps the iteration buffer into the back frame through the cached palette for its iteration limit
+void colorizeBuffer(const ViewSnapshot& view, FrameBuffer& frame) {
+    const int maxIter = bufferMaxIter;
+    const COLORREF* palette = currentPalette(maxIter, view.color, view.gradient).colors.data();
+    const bool smooth = view.smooth;
+    const ColorKernel colorize = colorKernelFor(view);
+
+    // GDI may still be reading this bitmap from its last time as the front buffer
+    GdiFlush();
+    renderPool->parallelFor(bufferHeight, [&](int row) {
+        const int offset = row * bufferStride;
+        colorize(iterationBuffer.data() + offset, smoothBuffer.data() + offset, bufferWidth, palette, maxIter, smooth, frame.pixels + row * frame.width);
+        });
+}
+
+// Colors the iteration buffer into the back frame, then makes it the front frame
+void publishFrame(const ViewSnapshot& view) {
+    FrameBuffer& back = frameBuffers[1 - frontFrame];
+    if (!ensureFrameBuffer(back, bufferWidth, bufferHeight)) {
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    colorizeBuffer(view, back);
+    if (useProfiling.load()) {
+        currentProfile.colorMs += millisecondsSince(start);
+        ++currentProfile.passes;
+    }
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        frontFrame = 1 - frontFrame;
+    }
+    InvalidateRect(hwnd, nullptr, FALSE);
+}
+
+// Text of the last profiled frame and the cache counters, for the overlay and 'stats'
+std::string profileSummary() {
+    FrameProfile profile;
+    {
+        std::lock_guard<std::mutex> lock(profileMutex);
+        profile = lastProfile;
+    }
+    if (!profile.valid) {
+        return "No profiled frame yet";
+    }
+
+    auto percent = [](double part, double whole) { return whole > 0.0 ? static_cast<int>(100.0 * part / whole + 0.5) : 0; };
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "Frame " << profile.width << "x" << profile.height << " at " << profile.maxIter << " iterations"
+        << (profile.recomputed ? "" : " (recolored)") << ": " << profile.totalMs << " ms\n";
+    out << "  orbit " << profile.orbitMs << " ms, compute " << profile.computeMs << " ms, color " << profile.colorMs
+        << " ms (" << profile.passes << " passes), blit " << lastBlitMicros.load() * 1e-3 << " ms\n";
+    out << "  " << profile.iterations * 1e-6 << " M iterations, "
+        << (profile.computeMs > 0.0 ? profile.iterations * 1e-3 / profile.computeMs : 0.0) << " Miter/s, "
+        << profile.allocations << " heap allocations\n";
+    out << "  workers busy:";
+    for (double busy : profile.busyMs) {
+        out << " " << percent(busy, profile.totalMs) << "%";
+    }
+    out << "\n  caches: frame pixels " << percent(static_cast<double>(cacheCounters.reusedPixels), static_cast<double>(cacheCounters.framePixels))
+        << "% reused, palette " << cacheCounters.paletteHits << "/" << cacheCounters.paletteLookups
+        << " hits, orbit " << cacheCounters.orbitHits << "/" << cacheCounters.orbitLookups << " hits ("
+        << cacheCounters.orbitExtensions << " extended), " << cacheCounters.resumes << " frames resumed";
+    return out.str();
+}
+
+// Blits the latest finished frame to the window, with the profile on top while profiling
+void presentBuffer(HDC hdc) {
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+        const FrameBuffer& front = frameBuffers[frontFrame];
+        if (front.dc) {
+            const auto start = std::chrono::steady_clock::now();
+            BitBlt(hdc, 0, 0, front.width, front.height, front.dc, 0, 0, SRCCOPY);
+            lastBlitMicros.store(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    if (useProfiling.load()) {
+        const std::string text = profileSummary();
+        RECT area = { 8, 8, 8, 8 };
+        SetBkMode(hdc, OPAQUE);
+        SetBkColor(hdc, RGB(0, 0, 0));
+        SetTextColor(hdc, RGB(255, 255, 255));
+        DrawTextA(hdc, text.c_str(), static_cast<int>(text.size()), &area, DT_LEFT | DT_TOP | DT_NOCLIP);
+    }
+}
+
+// Completes the profile of a finished frame, hands it to the overlay and 'stats', and repaints
+void finishProfile(bool recomputed, std::chrono::steady_clock::time_point start) {
+    FrameProfile& profile = currentProfile;
+    profile.allocations = heapAllocations.load() - profile.allocations;
+    profile.totalMs = millisecondsSince(start);
+    profile.valid = true;
+    profile.recomputed = recomputed;
+    profile.width = bufferWidth;
+    profile.height = bufferHeight;
+    profile.maxIter = bufferMaxIter;
+    profile.computeMs = recomputed ? std::max(profile.totalMs - profile.orbitMs - profile.colorMs, 0.0) : 0.0;
+    profile.iterations = frameIterations.load();
+    profile.busyMs = renderPool->takeBusyTimes();
+    {
+        std::lock_guard<std::mutex> lock(profileMutex);
+        lastProfile = profile;
+    }
+    InvalidateRect(hwnd, nullptr, FALSE);
+}
+
+// Byte streams of farm messages and cache files. Every machine involved is x86, so values are
+// stored in their native little-endian layout.
+struct WireWriter {
+    std::vector<uint8_t> bytes;
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "values are sent as raw bytes");
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(&value);
+        bytes.insert(bytes.end(), raw, raw + sizeof(T));
+    }
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    void putFloatExp(FloatExp value) {
+        put(value.mantissa);
+        put(static_cast<int32_t>(value.exponent));
+    }
+
+    void putBigFloat(const BigFloat& value) {
+        put(static_cast<int32_t>(value.precision));
+        put(static_cast<uint8_t>(value.negative));
+        for (int k = 0; k <= value.precision; ++k) {
+            put(value.limb[k]);
+        }
+    }
+
+    void putString(const std::string& value) {
+        putVarint(value.size());
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+};
+
+// Reads a payload; running past its end or reading a malformed value clears `ok`
+struct WireReader {
+    const uint8_t* next;
+    const uint8_t* end;
+    bool ok = true;
+
+    WireReader(const uint8_t* begin, const uint8_t* end) : next(begin), end(end) {}
+    WireReader(const std::vector<uint8_t>& payload) : WireReader(payload.data(), payload.data() + payload.size()) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (static_cast<size_t>(end - next) < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, next, sizeof(T));
+        next += sizeof(T);
+        return value;
+    }
+
+    uint64_t getVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && ok; shift += 7) {
+            const uint8_t byte = get<uint8_t>();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    FloatExp getFloatExp() {
+        const double mantissa = get<double>();
+        return FloatExp(mantissa, get<int32_t>());
+    }
+
+    BigFloat getBigFloat() {
+        BigFloat value;
+        const int32_t precision = get<int32_t>();
+        if (precision < 0 || precision > BIG_LIMBS) {
+            ok = false;
+            return value;
+        }
+        value.precision = precision;
+        value.negative = get<uint8_t>() != 0;
+        for (int k = 0; k <= precision; ++k) {
+            value.limb[k] = get<uint32_t>();
+        }
+        return value;
+    }
+
+    std::string getString() {
+        const uint64_t size = getVarint();
+        if (!ok || size > static_cast<uint64_t>(end - next)) {
+            ok = false;
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char*>(next), static_cast<size_t>(size));
+        next += size;
+        return value;
+    }
+};
+
+
+// Codes buffer rows y0..y0 + rows as runs of equal counts, each its length and the zigzag
+// difference from the previous run's count, then with `smooth` the fraction of every escaped pixel
+void encodeRows(WireWriter& out, int y0, int rows, int width, int maxIter, bool smooth) {
+    int previous = 0;
+    for (int py = y0; py < y0 + rows; ++py) {
+        const int* row = &iterationBuffer[py * bufferStride];
+        for (int px = 0; px < width;) {
+            int run = 1;
+            while (px + run < width && row[px + run] == row[px]) {
+                ++run;
+            }
+            const int64_t delta = static_cast<int64_t>(row[px]) - previous;
+            out.putVarint(run);
+            out.putVarint(delta >= 0 ? 2 * static_cast<uint64_t>(delta) : 2 * static_cast<uint64_t>(-delta) - 1);
+            previous = row[px];
+            px += run;
+        }
+    }
+    if (smooth) {
+        for (int py = y0; py < y0 + rows; ++py) {
+            for (int px = 0; px < width; ++px) {
+                if (iterationBuffer[py * bufferStride + px] < maxIter) {
+                    out.put(smoothBuffer[py * bufferStride + px]);
+                }
+            }
+        }
+    }
+}
+
+// Inverse of encodeRows; false if the data does not describe exactly those rows
+bool decodeRows(WireReader& in, int y0, int rows, int width, int maxIter, bool smooth) {
+    int previous = 0;
+    for (int py = y0; py < y0 + rows; ++py) {
+        int* row = &iterationBuffer[py * bufferStride];
+        for (int px = 0; px < width;) {
+            const uint64_t run = in.getVarint();
+            const uint64_t zigzag = in.getVarint();
+            const int64_t value = previous + ((zigzag & 1) ? -static_cast<int64_t>(zigzag >> 1) - 1 : static_cast<int64_t>(zigzag >> 1));
+            if (!in.ok || run == 0 || run > static_cast<uint64_t>(width - px) || value < 0 || value > maxIter) {
+                return false;
+            }
+            std::fill(row + px, row + px + run, static_cast<int>(value));
+            previous = static_cast<int>(value);
+            px += static_cast<int>(run);
+        }
+    }
+    for (int py = y0; py < y0 + rows; ++py) {
+        for (int px = 0; px < width; ++px) {
+            const int index = py * bufferStride + px;
+            smoothBuffer[index] = smooth && iterationBuffer[index] < maxIter ? in.get<float>() : 0.0f;
+        }
+    }
+    return in.ok && in.next == in.end;
+}
+
+// Cache files. With "diskcache on", a viewer frame that took over DISK_CACHE_SECONDS is written
+// to cacheDirectory(), named by a hash of its view. Reopening that view, after a restart too,
+// maps the file and decodes the frame instead of computing it. The file also holds the reference
+// orbit, so a deep view reopened at another limit only extends the orbit. The render thread only
+// encodes a file; the CacheWriter thread writes it, then deletes the least recently used files
+// while the directory holds over DISK_CACHE_BYTES. A hit refreshes its file's write time.
+//
+// Layout, all little-endian: the header (magic, version, the byte offset and size of each
+// section), then the sections. The key is the serialized view, compared in full on load, so a
+// hash collision is only a miss. The pixels are the farm's run-length coded counts with the
+// fractions of escaped pixels. The orbit table holds the orbit's settings, its center and
+// final Z in full precision, then every Z as raw doubles.
+const char CACHE_MAGIC[8] = { 'F', 'R', 'A', 'C', 'T', 'A', 'L', 0x1A };
+const uint32_t CACHE_VERSION = 3;
+const double DISK_CACHE_SECONDS = 0.5;
+const uint64_t DISK_CACHE_BYTES = 1ull << 30;
+const size_t CACHE_QUEUE_FILES = 4;
+
+enum CacheSection { SECTION_KEY, SECTION_PIXELS, SECTION_ORBIT, SECTION_COUNT };
+
+std::atomic<bool> useDiskCache(false);
+
+// Under the user's local application data, or the working directory without one
+const std::string& cacheDirectory() {
+    static const std::string directory = [] {
+        char base[MAX_PATH];
+        const DWORD length = GetEnvironmentVariableA("LOCALAPPDATA", base, MAX_PATH);
+        return length > 0 && length < MAX_PATH ? std::string(base) + "/fractal-cache" : std::string("fractal-cache");
+    }();
+    return directory;
+}
+
+// Writes cache files and refreshes their write times on its own thread, in the order queued
+class CacheWriter {
+public:
+    CacheWriter() : worker([this] { run(); }) {}
+
+    // Writes the files still queued
+    ~CacheWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        work.notify_one();
+        worker.join();
+    }
+
+    CacheWriter(const CacheWriter&) = delete;
+    CacheWriter& operator=(const CacheWriter&) = delete;
+
+    // Queues a file made of the parts in order. With CACHE_QUEUE_FILES already pending the file
+    // is dropped rather than holding up the render thread; it would only save a recomputation.
+    void write(const char* path, std::vector<WireWriter> parts) {
+        push(Job{ path, std::move(parts) });
+    }
+
+    // Queues marking a file as just used
+    void touch(const char* path) {
+        push(Job{ path, std::vector<WireWriter>() });
+    }
+
+private:
+    struct Job {
+        std::string path;
+        std::vector<WireWriter> parts; // None to refresh the write time
+    };
+
+    void push(Job job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= CACHE_QUEUE_FILES) {
+                return;
+            }
+            queue.push_back(std::move(job));
+        }
+        work.notify_one();
+    }
+
+    void run() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work.wait(lock, [this] { return !queue.empty() || done; });
+                if (queue.empty()) {
+                    return;
+                }
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            if (job.parts.empty()) {
+                refresh(job.path);
+            }
+            else if (store(job)) {
+                evict();
+            }
+        }
+    }
+
+    // Written under a temporary name, so an interrupted write never leaves a partial cache file
+    static bool store(const Job& job) {
+        CreateDirectoryA(cacheDirectory().c_str(), nullptr);
+        const std::string partial = job.path + ".part";
+        {
+            std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+            for (const WireWriter& part : job.parts) {
+                out.write(reinterpret_cast<const char*>(part.bytes.data()), part.bytes.size());
+            }
+            if (!out) {
+                out.close();
+                std::remove(partial.c_str());
+                return false;
+            }
+        }
+        std::remove(job.path.c_str());
+        return std::rename(partial.c_str(), job.path.c_str()) == 0;
+    }
+
+    static void refresh(const std::string& path) {
+        HANDLE file = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file != INVALID_HANDLE_VALUE) {
+            FILETIME now;
+            GetSystemTimeAsFileTime(&now);
+            SetFileTime(file, nullptr, nullptr, &now);
+            CloseHandle(file);
+        }
+    }
+
+    // Deletes the files written or used longest ago until the rest fit in DISK_CACHE_BYTES. A
+    // file mapped by the render thread cannot be deleted, and is skipped.
+    static void evict() {
+        struct Entry {
+            uint64_t time, bytes;
+            std::string name;
+        };
+        std::vector<Entry> entries;
+        uint64_t total = 0;
+        const std::string& directory = cacheDirectory();
+        WIN32_FIND_DATAA found;
+        HANDLE search = FindFirstFileA((directory + "/*.frc").c_str(), &found);
+        if (search == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        do {
+            const uint64_t bytes = static_cast<uint64_t>(found.nFileSizeHigh) << 32 | found.nFileSizeLow;
+            const uint64_t time = static_cast<uint64_t>(found.ftLastWriteTime.dwHighDateTime) << 32 | found.ftLastWriteTime.dwLowDateTime;
+            entries.push_back(Entry{ time, bytes, found.cFileName });
+            total += bytes;
+        } while (FindNextFileA(search, &found));
+        FindClose(search);
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+        for (const Entry& entry : entries) {
+            if (total <= DISK_CACHE_BYTES) {
+                break;
+            }
+            if (DeleteFileA((directory + "/" + entry.name).c_str())) {
+                total -= entry.bytes;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable work;
+    std::deque<Job> queue; // Guarded by mutex
+    bool done = false;     // Guarded by mutex
+    std::thread worker;
+};
+
+CacheWriter* cacheWriter = nullptr; // Owned by main() in the viewer
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const char* path) {
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            return;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            bytes = data ? static_cast<size_t>(size.QuadPart) : 0;
+        }
+    }
+
+    ~MappedFile() {
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+};
+
+// Appends everything a frame's pixels depend on besides the iteration limit
+void putCacheKey(WireWriter& key, const ViewSnapshot& view) {
+    key.putBigFloat(view.centerX);
+    key.putBigFloat(view.centerY);
+    key.putFloatExp(view.viewWidth);
+    key.putFloatExp(view.viewHeight);
+    key.put(static_cast<int64_t>(view.panX));
+    key.put(static_cast<int64_t>(view.panY));
+    const int32_t settings[] = { view.width, view.height, view.kernel, view.backend, view.precision, view.samples,
+        view.perturbation, view.series, view.subdivide, view.formula, view.distance };
+    for (int32_t setting : settings) {
+        key.put(setting);
+    }
+    if (view.formula == FORMULA_JULIA) {
+        key.put(view.juliaX);
+        key.put(view.juliaY);
+    }
+}
+
+// Formatted in place, since every recomputed frame first looks for its file. False if the path
+// does not fit.
+bool cacheFilePath(const WireWriter& key, char (&path)[MAX_PATH]) {
+    uint64_t hash = 0xCBF29CE484222325ull; // FNV-1a
+    for (uint8_t byte : key.bytes) {
+        hash = (hash ^ byte) * 0x100000001B3ull;
+    }
+    const int length = std::snprintf(path, sizeof(path), "%s/%016llx.frc", cacheDirectory().c_str(), static_cast<unsigned long long>(hash));
+    return length > 0 && length < static_cast<int>(sizeof(path));
+}
+
+// Encodes the finished buffers of the view, and the reference orbit of its center if cached,
+// and queues the file on the cache writer
+void saveCacheFile(const ViewSnapshot& view) {
+    char path[MAX_PATH];
+    std::vector<WireWriter> parts(1 + SECTION_COUNT);
+    WireWriter& header = parts[0];
+    WireWriter* sections = parts.data() + 1;
+    putCacheKey(sections[SECTION_KEY], view);
+    if (!cacheFilePath(sections[SECTION_KEY], path)) {
+        return;
+    }
+    sections[SECTION_PIXELS].put(static_cast<int32_t>(view.maxIter));
+    encodeRows(sections[SECTION_PIXELS], 0, view.height, view.width, view.maxIter, true);
+    {
+        std::lock_guard<std::mutex> lock(orbitMutex);
+        if (view.precision == PRECISION_BIGNUM && view.perturbation && cachedOrbit && cachedOrbit->cx == view.centerX && cachedOrbit->cy == view.centerY) {
+            WireWriter& table = sections[SECTION_ORBIT];
+            table.put(static_cast<int32_t>(cachedOrbit->precision));
+            table.put(static_cast<int32_t>(cachedOrbit->maxIter));
+            table.put(static_cast<int32_t>(cachedOrbit->length));
+            table.putBigFloat(cachedOrbit->cx);
+            table.putBigFloat(cachedOrbit->cy);
+            table.putBigFloat(cachedOrbit->endZr);
+            table.putBigFloat(cachedOrbit->endZi);
+            const uint8_t* zr = reinterpret_cast<const uint8_t*>(cachedOrbit->zr.data());
+            const uint8_t* zi = reinterpret_cast<const uint8_t*>(cachedOrbit->zi.data());
+            table.bytes.insert(table.bytes.end(), zr, zr + cachedOrbit->zr.size() * sizeof(double));
+            table.bytes.insert(table.bytes.end(), zi, zi + cachedOrbit->zi.size() * sizeof(double));
+        }
+    }
+
+    header.bytes.assign(CACHE_MAGIC, CACHE_MAGIC + sizeof(CACHE_MAGIC));
+    header.put(CACHE_VERSION);
+    uint64_t offset = sizeof(CACHE_MAGIC) + sizeof(CACHE_VERSION) + SECTION_COUNT * 2 * sizeof(uint64_t);
+    for (int section = 0; section < SECTION_COUNT; ++section) {
+        header.put(offset);
+        header.put(static_cast<uint64_t>(sections[section].bytes.size()));
+        offset += sections[section].bytes.size();
+    }
+    cacheWriter->write(path, std::move(parts));
+}
+
+// Maps the view's cache file. Its orbit table replaces a reference orbit that does not cover
+// the view; its pixels fill the buffers if they were computed at the view's limit, in which case
+// it returns true. A damaged orbit table makes the whole file a miss.
+bool loadCacheFile(const ViewSnapshot& view) {
+    static WireWriter key; // Keeps its capacity, so missing files cost no allocation
+    key.bytes.clear();
+    putCacheKey(key, view);
+    char path[MAX_PATH];
+    if (!cacheFilePath(key, path)) {
+        return false;
+    }
+    const MappedFile file(path);
+    const size_t headerBytes = sizeof(CACHE_MAGIC) + sizeof(CACHE_VERSION) + SECTION_COUNT * 2 * sizeof(uint64_t);
+    if (file.bytes < headerBytes || std::memcmp(file.data, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+        return false;
+    }
+    WireReader header(file.data + sizeof(CACHE_MAGIC), file.data + headerBytes);
+    if (header.get<uint32_t>() != CACHE_VERSION) {
+        return false;
+    }
+    const uint8_t* begin[SECTION_COUNT];
+    const uint8_t* end[SECTION_COUNT];
+    for (int section = 0; section < SECTION_COUNT; ++section) {
+        const uint64_t offset = header.get<uint64_t>();
+        const uint64_t size = header.get<uint64_t>();
+        if (offset > file.bytes || size > file.bytes - offset) {
+            return false;
+        }
+        begin[section] = file.data + offset;
+        end[section] = begin[section] + size;
+    }
+    if (static_cast<size_t>(end[SECTION_KEY] - begin[SECTION_KEY]) != key.bytes.size() ||
+        std::memcmp(begin[SECTION_KEY], key.bytes.data(), key.bytes.size()) != 0) {
+        return false;
+    }
+
+    if (begin[SECTION_ORBIT] != end[SECTION_ORBIT]) {
+        WireReader table(begin[SECTION_ORBIT], end[SECTION_ORBIT]);
+        auto orbit = std::make_shared<ReferenceOrbit>();
+        orbit->precision = table.get<int32_t>();
+        orbit->maxIter = table.get<int32_t>();
+        orbit->length = table.get<int32_t>();
+        orbit->cx = table.getBigFloat();
+        orbit->cy = table.getBigFloat();
+        orbit->endZr = table.getBigFloat();
+        orbit->endZi = table.getBigFloat();
+        // The orbit may be extended later at its own precision, from its final Z, so everything
+        // that sizes that work must be consistent before it is trusted. The center keeps the
+        // precision of the view it came from, which covers() compares against.
+        const int precision = orbit->precision;
+        const bool consistent = table.ok && precision >= 0 && precision <= BIG_LIMBS && orbit->cx.precision == orbit->cy.precision &&
+            orbit->cx.precision >= precision && orbit->endZr.precision == precision && orbit->endZi.precision == precision &&
+            orbit->length >= 0 && orbit->length <= orbit->maxIter;
+        const size_t points = consistent ? static_cast<size_t>(orbit->length) + 1 : 0;
+        if (!consistent || static_cast<size_t>(table.end - table.next) != 2 * points * sizeof(double)) {
+            return false;
+        }
+        const double* zr = reinterpret_cast<const double*>(table.next);
+        orbit->zr.resize(points);
+        orbit->zi.resize(points);
+        std::memcpy(orbit->zr.data(), zr, points * sizeof(double));
+        std::memcpy(orbit->zi.data(), zr + points, points * sizeof(double));
+
+        std::lock_guard<std::mutex> lock(orbitMutex);
+        if (!cachedOrbit || !cachedOrbit->covers(orbit->cx, orbit->cy, orbit->precision, orbit->maxIter)) {
+            cachedOrbit = orbit;
+        }
+    }
+
+    WireReader pixels(begin[SECTION_PIXELS], end[SECTION_PIXELS]);
+    if (pixels.get<int32_t>() != view.maxIter || !pixels.ok) {
+        return false;
+    }
+    sizeBuffers(view.width, view.height);
+    if (!decodeRows(pixels, 0, view.height, view.width, view.maxIter, true)) {
+        return false;
+    }
+    bufferMaxIter = view.maxIter;
+    resumableFrame.valid = false;
+    cacheFrame(view);
+    cacheWriter->touch(path);
+    return true;
+}
+
+// Renders one frame into the back buffers, publishing each progressive pass. Palette-only
+// changes reuse the last iteration counts. Returns false if the frame was cancelled.
+template <typename CancelCheck>
+bool drawMandelbrot(const ViewSnapshot& view, bool recompute, CancelCheck cancelled) {
+    const bool profiling = useProfiling.load();
+    const auto start = std::chrono::steady_clock::now();
+    if (profiling) {
+        currentProfile = FrameProfile();
+        frameIterations = 0;
+        renderPool->takeBusyTimes();
+        currentProfile.allocations = heapAllocations.load();
+    }
+
+    bool finished = true;
+    recompute = recompute || view.width != bufferWidth || view.height != bufferHeight;
+    if (recompute) {
+        // A frame still held in memory is reused by computeIterations without reading its file
+        if (useDiskCache.load() && cacheWriter && !frameInCache(view) && loadCacheFile(view)) {
+            publishFrame(view);
+        }
+        else {
+            finished = computeIterations(view, cancelled, [&]() {
+                publishFrame(view);
+                });
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (finished && useDiskCache.load() && cacheWriter && seconds > DISK_CACHE_SECONDS) {
+                saveCacheFile(view);
+            }
+        }
+    }
+    else {
+        publishFrame(view);
+    }
+
+    if (profiling && finished) {
+        finishProfile(recompute, start);
+    }
+    return finished;
+}
+
+// Render requests are numbered; the render thread always jumps to the newest one and abandons
+// a frame in progress as soon as a newer request arrives, so stale frames never queue up
+std::mutex renderMutex;
+std::condition_variable renderSignal;
+std::atomic<unsigned long long> requestedFrame(0);
+
+void requestRender(bool recompute) {
+    std::lock_guard<std::mutex> lock(renderMutex);
+    if (recompute) {
+        needsRecompute.store(true);
+    }
+    ++requestedFrame;
+    renderSignal.notify_one();
+}
+
+// Pixel under the cursor, guarded by renderMutex. Moves are numbered like frames, so that each
+// supersedes the last.
+int hoverX = 0, hoverY = 0;
+std::atomic<unsigned long long> hoverMove(0);
+const int HOVER_SETTLE_MS = 150; // How long the cursor rests on a pixel before its click is speculated
+
+void requestSpeculation(int mouseX, int mouseY) {
+    std::lock_guard<std::mutex> lock(renderMutex);
+    hoverX = mouseX;
+    hoverY = mouseY;
+    ++hoverMove;
+    renderSignal.notify_one();
+}
+
+// Automatic iteration limit. The last frame's escape counts show what its boundary needed: when
+// more than LATE_ESCAPE_SHARE of the pixels escape in the last quarter of the limit, the limit
+// cuts the boundary off and is doubled, which only continues the unfinished pixels. A zoom starts
+// from the count 99.9% of the escapes stayed under, plus ITER_PER_OCTAVE for every halving of
+// the view width, since boundary escape times grow with log(zoom).
+const double LATE_ESCAPE_SHARE = 0.001;
+const int ITER_PER_OCTAVE = 50;
+
+std::atomic<bool> useAdaptiveIterations(true); // Turned off by setting a fixed limit
+
+struct EscapeStats {
+    int maxIter = 0;        // Limit the frame was computed with; 0 before the first frame
+    int tailCount = 0;      // Count 99.9% of the escaping pixels escape within
+    double lateShare = 0.0; // Share of all pixels escaping in the last quarter of the limit
+};
+
+std::mutex statsMutex;
+EscapeStats lastEscapeStats; // Guarded by statsMutex
+
+EscapeStats measureEscapes(int width, int height, int maxIter) {
+    const int bins = 256;
+    int histogram[bins] = {};
+    int escaped = 0, late = 0;
+    for (int py = 0; py < height; ++py) {
+        const int* row = &iterationBuffer[py * bufferStride];
+        for (int px = 0; px < width; ++px) {
+            if (row[px] < maxIter) {
+                ++escaped;
+                ++histogram[static_cast<long long>(row[px]) * bins / maxIter];
+                late += 4 * static_cast<long long>(row[px]) >= 3 * static_cast<long long>(maxIter);
+            }
+        }
+    }
+
+    EscapeStats stats;
+    stats.maxIter = maxIter;
+    stats.lateShare = static_cast<double>(late) / (static_cast<double>(width) * height);
+    stats.tailCount = escaped == 0 ? maxIter : 0; // Nothing escaped: no evidence for a lower limit
+    int remaining = escaped - escaped / 1000;
+    for (int bin = 0; bin < bins && remaining > 0; ++bin) {
+        remaining -= histogram[bin];
+        stats.tailCount = static_cast<int>(static_cast<long long>(bin + 1) * maxIter / bins);
+    }
+    return stats;
+}
+
+// Perturbation keeps deep zooms fast enough to lift the usual cap
+int iterationCap(int precision, bool perturbation) {
+    return precision == PRECISION_BIGNUM && perturbation ? MAX_DEEP_ITER : MAX_ITER;
+}
+
+// Chooses the limit for a view of the given width, `zoomStep` times narrower than the last frame
+int adaptiveMaxIter(const EscapeStats& stats, FloatExp width, double zoomStep, int cap) {
+    double estimate = BASE_ITER + ITER_PER_OCTAVE * std::max(0.0, std::log2(initialViewWidth) - width.log2());
+    if (stats.maxIter > 0) {
+        estimate = stats.tailCount * 1.25 + ITER_PER_OCTAVE * std::log2(zoomStep);
+        if (stats.lateShare > LATE_ESCAPE_SHARE) {
+            estimate = std::max(estimate, 2.0 * stats.maxIter);
+        }
+    }
+    return static_cast<int>(std::min<double>(std::max<double>(estimate, BASE_ITER), cap));
+}
+
+// Records the escape statistics of a finished frame and, with the automatic limit, raises the
+// limit again while the frame's boundary is still cut off
+void adaptIterations(const ViewSnapshot& view) {
+    const EscapeStats stats = measureEscapes(bufferWidth, bufferHeight, bufferMaxIter);
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        lastEscapeStats = stats;
+    }
+    if (!useAdaptiveIterations.load() || stats.lateShare <= LATE_ESCAPE_SHARE) {
+        return;
+    }
+
+    // Only if nobody changed the limit since this frame was snapshotted
+    int expected = view.maxIter;
+    const int raised = std::min(2 * view.maxIter, iterationCap(view.precision, view.perturbation));
+    if (raised > expected && currentMaxIter.compare_exchange_strong(expected, raised)) {
+        std::cout << "Raised iterations to " << raised << " to resolve the boundary\n";
+        requestRender(true);
+    }
+}
+
+// Speculative rendering. While the render thread is idle it computes views the user is likely to
+// go to next: the next step of a replayed zoom path, and the view a click on the hovered pixel
+// would zoom to. The work runs at below-normal priority and stops as soon as a frame is
+// requested, and the frame on screen stays untouched. Going to that view then finds it done.
+
+// Where the frame on screen waits meanwhile; kept between uses, so speculating does not allocate
+AlignedVector<int> asideIterations;
+AlignedVector<float> asideFractions;
+ResumableFrame asideResumable;
+
+template <typename CancelCheck, typename PassCallback>
+bool computeSpeculatively(const ViewSnapshot& view, CancelCheck cancelled, PassCallback onPass, CachedFrame* computed = nullptr) {
+    if (view.width != bufferWidth || view.height != bufferHeight) {
+        return false; // The frame on screen is about to be resized anyway
+    }
+
+    // Set the frame on screen aside: its buffers, unfinished pixels and reference orbit
+    asideIterations.resize(iterationBuffer.size());
+    asideFractions.resize(smoothBuffer.size());
+    iterationBuffer.swap(asideIterations);
+    smoothBuffer.swap(asideFractions);
+    const int shownMaxIter = bufferMaxIter;
+    asideResumable.pixels.clear();
+    asideResumable.valid = false;
+    std::swap(resumableFrame, asideResumable);
+    std::shared_ptr<const ReferenceOrbit> shownOrbit;
+    {
+        std::lock_guard<std::mutex> lock(orbitMutex);
+        shownOrbit = cachedOrbit;
+    }
+
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+    renderPool->setPriority(THREAD_PRIORITY_BELOW_NORMAL);
+    const bool finished = computeIterations(view, cancelled, onPass);
+    renderPool->setPriority(THREAD_PRIORITY_NORMAL);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+
+    iterationBuffer.swap(asideIterations);
+    smoothBuffer.swap(asideFractions);
+    bufferMaxIter = shownMaxIter;
+    std::swap(resumableFrame, asideResumable);
+    if (computed) {
+        computed->view = view;
+        computed->iterations.swap(asideIterations);
+        computed->fractions.swap(asideFractions);
+    }
+    {
+        std::lock_guard<std::mutex> lock(orbitMutex);
+        if (cachedOrbit != shownOrbit) {
+            speculativeOrbit = cachedOrbit;
+            cachedOrbit = shownOrbit;
+        }
+    }
+    return finished;
+}
+
+// Zoom path replay. "load <file>" reads a path file as videos do and "goto <n>" shows its steps.
+// While a step is on screen and nothing else is pending, the render thread computes the next
+// step into the frame cache at low priority. It gives way as soon as a frame is requested, and
+// stepping forward then finds its frame already done.
+
+// Limit for a view replaced by a zoom from a view `fromWidth` wide, as a click would set it
+int replayIterations(FloatExp fromWidth, const ViewSnapshot& view) {
+    const int cap = iterationCap(view.precision, view.perturbation);
+    if (!useAdaptiveIterations.load()) {
+        return std::min(currentMaxIter.load(), cap);
+    }
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return adaptiveMaxIter(lastEscapeStats, view.viewWidth, std::exp2(fromWidth.log2() - view.viewWidth.log2()), cap);
+}
+
+// The view of a path step shown after `current`. Going to the step and prerendering it both run
+// while the frame on screen is current, so they arrive at the same limit.
+ViewSnapshot replayView(const ViewSnapshot& current, const PathPoint& point) {
+    ViewSnapshot view = current;
+    view.centerX = point.x;
+    view.centerY = point.y;
+    view.panX = 0;
+    view.panY = 0;
+    view.viewWidth = point.width;
+    view.viewHeight = point.width * (static_cast<double>(view.height) / view.width);
+    view.precision = choosePrecision(std::min(view.viewWidth * (1.0 / view.width), view.viewHeight * (1.0 / view.height)));
+    view.maxIter = replayIterations(current.viewWidth, view);
+    return view;
+}
+
+// Computes the replay step after the one on screen into the frame cache
+template <typename CancelCheck>
+void prerenderReplayStep(const ViewSnapshot& current, CancelCheck cancelled) {
+    PathPoint next;
+    {
+        std::lock_guard<std::mutex> lock(viewMutex);
+        if (replayStep >= static_cast<int>(replayPath.size())) {
+            return;
+        }
+        next = replayPath[replayStep];
+    }
+    const ViewSnapshot view = replayView(current, next);
+    if (!cancelled() && !frameInCache(view)) {
+        computeSpeculatively(view, cancelled, []() {});
+    }
+}
+
+// The view a click at (mouseX, mouseY) zooms `current` to, 10x around the clicked point
+const double CLICK_ZOOM = 0.1;
+
+ViewSnapshot clickZoomView(const ViewSnapshot& current, int mouseX, int mouseY) {
+    // Move the center in full precision; the offset itself is small enough for long double
+    ViewSnapshot view = current;
+    view.centerX = current.centerX + BigFloat(current.viewWidth * (static_cast<double>(mouseX + current.panX) / current.width - 0.5));
+    view.centerY = current.centerY + BigFloat(current.viewHeight * (static_cast<double>(mouseY + current.panY) / current.height - 0.5));
+    view.panX = 0;
+    view.panY = 0;
+    view.viewWidth = current.viewWidth * CLICK_ZOOM;
+    view.viewHeight = current.viewHeight * CLICK_ZOOM;
+    view.precision = choosePrecision(std::min(view.viewWidth * (1.0 / view.width), view.viewHeight * (1.0 / view.height)));
+
+    // Increase the iterations after zoom
+    const int cap = iterationCap(view.precision, view.perturbation);
+    if (useAdaptiveIterations.load()) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        view.maxIter = adaptiveMaxIter(lastEscapeStats, view.viewWidth, 1.0 / CLICK_ZOOM, cap);
+    }
+    else {
+        view.maxIter = std::min(current.maxIter + 250, cap);
+    }
+    return view;
+}
+
+// Extends `orbit`, an unescaped orbit of (x, y), or starts one, until it covers maxIter. A new
+// request interrupts it within ORBIT_CANCEL_INTERVAL iterations. Returns null if cancelled,
+// after keeping what was done in speculativeOrbit, where the next hover over the same pixel or
+// the click itself continues it.
+template <typename CancelCheck>
+std::shared_ptr<const ReferenceOrbit> extendOrbitSpeculatively(const BigFloat& x, const BigFloat& y, int precision, int maxIter,
+    std::shared_ptr<const ReferenceOrbit> orbit, CancelCheck cancelled) {
+    if (orbit && orbit->covers(x, y, precision, maxIter)) {
+        return orbit;
+    }
+    orbit = orbit ? computeReferenceOrbit(x, y, orbit->precision, maxIter, orbit.get(), cancelled) : computeReferenceOrbit(x, y, precision, maxIter, nullptr, cancelled);
+    if (!orbit->covers(x, y, precision, maxIter)) {
+        std::lock_guard<std::mutex> lock(orbitMutex);
+        speculativeOrbit = orbit;
+        return nullptr;
+    }
+    return orbit;
+}
+
+// Computes the reference orbit and the first progressive passes of the view a click on the
+// hovered pixel would show. Deep views spend most of their first pass on the orbit, so it
+// comes first; it runs on this thread and checks for requests as it goes.
+template <typename CancelCheck>
+void speculateClick(const ViewSnapshot& current, int mouseX, int mouseY, CancelCheck cancelled) {
+    const ViewSnapshot view = clickZoomView(current, mouseX, mouseY);
+    const bool previewed = clickPreviewValid && sameGrid(clickPreview.view, view) && clickPreview.view.panX == 0 && clickPreview.view.panY == 0;
+    if (previewed || frameInCache(view)) {
+        return;
+    }
+
+    if (view.precision == PRECISION_BIGNUM && view.perturbation) {
+        const FloatExp spacing = std::min(view.viewWidth * (1.0 / view.width), view.viewHeight * (1.0 / view.height));
+        const int precision = bigFloatPrecisionFor(spacing);
+        std::shared_ptr<const ReferenceOrbit> orbit;
+        {
+            std::lock_guard<std::mutex> lock(orbitMutex);
+            if (speculativeOrbit && speculativeOrbit->cx == view.centerX && speculativeOrbit->cy == view.centerY && speculativeOrbit->precision >= precision) {
+                orbit = speculativeOrbit;
+            }
+        }
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+        orbit = extendOrbitSpeculatively(view.centerX, view.centerY, precision, view.maxIter, orbit, cancelled);
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+        if (!orbit) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(orbitMutex);
+        speculativeOrbit = orbit;
+    }
+
+    // Only the progressive tile passes can start from a preview
+    if (!view.progressive || view.subdivide || view.distance || usesGpu(view)) {
+        return;
+    }
+    int nextStep = PREVIEW_STEP;
+    auto done = [&]() { return nextStep < CLICK_PREVIEW_STEP; };
+    clickPreviewValid = false;
+    computeSpeculatively(view, [&]() { return done() || cancelled(); }, [&]() { nextStep /= 2; }, &clickPreview);
+    clickPreviewValid = done();
+}
+
+// Pool settings from the "threads" command, which the render thread applies before its next
+// frame, since the pool can only change between frames
+struct PoolRequest {
+    bool pending = false;
+    bool reconfigure = false; // False only reports the current workers
+    int workers = 0;
+    int policy = -1;          // -1 keeps the current affinity policy
+};
+
+std::mutex poolRequestMutex;
+PoolRequest poolRequest; // Guarded by poolRequestMutex
+
+void applyPoolRequest() {
+    PoolRequest request;
+    {
+        std::lock_guard<std::mutex> lock(poolRequestMutex);
+        std::swap(request, poolRequest);
+    }
+    if (!request.pending) {
+        return;
+    }
+    if (request.reconfigure) {
+        renderPool->configure(request.workers, request.policy < 0 ? renderPool->affinityPolicy() : request.policy);
+    }
+    std::cout << "Rendering with " << renderPool->describe() << ".\n";
+}
+
+void renderLoop() {
+    renderingThread = true;
+    unsigned long long frame = 0;
+    unsigned long long move = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock(renderMutex);
+        renderSignal.wait(lock, [&]() { return !running || requestedFrame.load() != frame || hoverMove.load() != move; });
+        if (!running) {
+            return;
+        }
+        if (requestedFrame.load() == frame) {
+            // Only the cursor moved. Speculation waits until it has rested for HOVER_SETTLE_MS, so
+            // sweeping across the window does not start a view at every pixel it passes; a frame
+            // request or the next move interrupts both the wait and the speculation.
+            move = hoverMove.load();
+            auto interrupted = [&]() { return !running || requestedFrame.load() != frame || hoverMove.load() != move; };
+            if (renderSignal.wait_for(lock, std::chrono::milliseconds(HOVER_SETTLE_MS), interrupted)) {
+                continue;
+            }
+            const int mouseX = hoverX, mouseY = hoverY;
+            lock.unlock();
+            if (useSpeculation.load()) {
+                speculateClick(takeSnapshot(), mouseX, mouseY, interrupted);
+            }
+            continue;
+        }
+        frame = requestedFrame.load();
+        const bool recompute = needsRecompute.exchange(false);
+        lock.unlock();
+
+        applyPoolRequest();
+        const ViewSnapshot view = takeSnapshot();
+        auto cancelled = [&]() { return !running || requestedFrame.load() != frame; };
+        if (!drawMandelbrot(view, recompute, cancelled)) {
+            // The iteration buffer is half old, half new, so the next frame must recompute
+            needsRecompute.store(true);
+        }
+        else {
+            if (recompute) {
+                adaptIterations(view);
+            }
+            if (useSpeculation.load()) {
+                prerenderReplayStep(view, cancelled);
+            }
+        }
+    }
+}
+
+// Headless rendering of stills through the same engine, for sizes far beyond the window. The
+// frame is computed in bands of STILL_BAND_ROWS rows, each a view panned down from the frame's
+// center, and every band is colored and appended to the file before the next one starts, so
+// memory only ever holds one band.
+const int STILL_BAND_ROWS = 2 * TILE_SIZE;
+
+// Writes an 8-bit RGB image band by band, as PNG or as raw top-down RGB bytes. The PNG holds
+// one IDAT chunk per band with stored (uncompressed) deflate blocks, since compressing would
+// need zlib; recompress the file afterwards if its size matters.
+class ImageWriter {
+public:
+    bool open(const std::string& path, int width, int height, bool png) {
+        this->width = width;
+        this->png = png;
+        out.open(path, std::ios::binary);
+        if (!out || !png) {
+            return static_cast<bool>(out);
+        }
+
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+        uint8_t header[13] = {};
+        putBigEndian(header, static_cast<uint32_t>(width));
+        putBigEndian(header + 4, static_cast<uint32_t>(height));
+        header[8] = 8; // Bit depth
+        header[9] = 2; // RGB
+        writeChunk("IHDR", header, sizeof(header));
+
+        chunk.assign({ 0x78, 0x01 }); // zlib header: deflate, 32K window, no preset dictionary
+        return static_cast<bool>(out);
+    }
+
+    // Appends `rows` rows of width * 3 bytes
+    void writeRows(const uint8_t* rgb, int rows) {
+        const size_t rowBytes = static_cast<size_t>(width) * 3;
+        if (!png) {
+            out.write(reinterpret_cast<const char*>(rgb), rowBytes * rows);
+            return;
+        }
+
+        // Every row starts with filter type 0 (none)
+        scanlines.clear();
+        for (int row = 0; row < rows; ++row) {
+            scanlines.push_back(0);
+            scanlines.insert(scanlines.end(), rgb + row * rowBytes, rgb + (row + 1) * rowBytes);
+        }
+        adler = adler32(adler, scanlines.data(), scanlines.size());
+        for (size_t offset = 0; offset < scanlines.size(); offset += 65535) {
+            const uint16_t length = static_cast<uint16_t>(std::min<size_t>(65535, scanlines.size() - offset));
+            const uint8_t block[5] = { 0, static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8) };
+            chunk.insert(chunk.end(), block, block + 5);
+            chunk.insert(chunk.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+        }
+        writeChunk("IDAT", chunk.data(), chunk.size());
+        chunk.clear();
+    }
+
+    bool close() {
+        if (png) {
+            // An empty final block ends the deflate stream, followed by the Adler-32 of the data
+            chunk.assign({ 1, 0, 0, 0xFF, 0xFF, 0, 0, 0, 0 });
+            putBigEndian(chunk.data() + 5, adler);
+            writeChunk("IDAT", chunk.data(), chunk.size());
+            writeChunk("IEND", nullptr, 0);
+        }
+        out.close();
+        return !out.fail();
+    }
+
+private:
+    static void putBigEndian(uint8_t* target, uint32_t value) {
+        target[0] = static_cast<uint8_t>(value >> 24);
+        target[1] = static_cast<uint8_t>(value >> 16);
+        target[2] = static_cast<uint8_t>(value >> 8);
+        target[3] = static_cast<uint8_t>(value);
+    }
+
+    static uint32_t adler32(uint32_t adler, const uint8_t* data, size_t size) {
+        uint32_t a = adler & 0xFFFF, b = adler >> 16;
+        for (size_t i = 0; i < size; ++i) {
+            a = (a + data[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> entries(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+            return entries;
+        }();
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    void writeChunk(const char* type, const uint8_t* data, size_t size) {
+        uint8_t field[4];
+        putBigEndian(field, static_cast<uint32_t>(size));
+        out.write(reinterpret_cast<const char*>(field), 4);
+        out.write(type, 4);
+        if (size > 0) {
+            out.write(reinterpret_cast<const char*>(data), size);
+        }
+        uint32_t crc = crc32(0xFFFFFFFFu, reinterpret_cast<const uint8_t*>(type), 4);
+        crc = crc32(crc, data, size) ^ 0xFFFFFFFFu;
+        putBigEndian(field, crc);
+        out.write(reinterpret_cast<const char*>(field), 4);
+    }
+
+    std::ofstream out;
+    int width = 0;
+    bool png = true;
+    uint32_t adler = 1;
+    std::vector<uint8_t> chunk, scanlines;
+};
+
+// Settings of a headless render, gathered from the command line
+struct HeadlessOptions {
+    std::string output;    // Still image file, or the file name prefix of a video's frames
+    bool video = false;
+    std::string pathFile;  // Zoom path the video follows
+    int sequence = 1;      // Which zoom of the path file, counting from 1
+    int octaveFrames = 24; // Video frames per halving of the view width
+    bool bench = false;
+    int repeats = 5;       // Timed frames per benchmark configuration
+    std::string farm;      // Comma-separated host:port workers that compute stills and videos
+    int workerPort = 0;    // Nonzero serves as a farm worker on this port instead
+    std::string bindAddress = "127.0.0.1"; // Interface a worker listens on; 0.0.0.0 for all of them
+    std::string secret;    // Coordinator and workers only talk to each other when theirs match
+    int width = WIDTH, height = HEIGHT;
+    BigFloat centerX = BigFloat(initialCenterX), centerY = BigFloat(initialCenterY);
+    FloatExp viewWidth = FloatExp(initialViewWidth);
+    int iterations = 0; // 0 picks the limit from the zoom depth
+    bool color = true, smooth = false, subdivide = false, perturbation = true, series = true, distance = false;
+    int samples = 1;
+    int formula = FORMULA_MANDELBROT;
+    double juliaX = initialJuliaX, juliaY = initialJuliaY;
+    int threads = 0; // Render workers; 0 places one per logical processor (or core)
+    int affinity = AFFINITY_THREADS;
+};
+
+void printHeadlessUsage() {
+    std::cout << "Usage: fractal --render <file.png|file.raw> [--center <x> <y>] [--width <view width>] [options]\n"
+        << "       fractal --video <frame prefix> --path <file> [--sequence <n>] [--octave-frames <n>] [options]\n"
+        << "       fractal --bench [--repeats <n>] [options]\n"
+        << "       fractal --worker <port> [--bind <address>] [--secret <text>] [--kernel <name>] [--backend <cpu|gpu>]\n"
+        << "       [--threads <n>] [--affinity <none|cores|threads>]\n"
+        << "Options: [--size <width>x<height>] [--iterations <number|auto>] [--kernel <name>] [--backend <cpu|gpu>]\n"
+        << "       [--precision <name>] [--gradient <file>] [--grayscale] [--smooth] [--distance] [--antialias <4|16>]\n"
+        << "       [--subdivide] [--no-perturbation] [--no-series] [--farm <host:port>[,<host:port>...]] [--secret <text>]\n"
+        << "       [--formula <mandelbrot|multibrot3|multibrot4|multibrot5|julia|burningship|tricorn>] [--julia <re> <im>]\n"
+        << "       [--threads <n>] [--affinity <none|cores|threads>]\n"
+        << "Raw files hold width * height * 3 bytes of top-down RGB. Video frames are written as\n"
+        << "<prefix>00000.png, <prefix>00001.png, ... (ffmpeg -i <prefix>%05d.png encodes them). Path files\n"
+        << "hold \"x y width\" per line, or the centers the viewer logs after each click. --farm has stills\n"
+        << "and videos computed by machines running --worker with the same --secret. Workers listen on\n"
+        << "127.0.0.1 unless --bind names another interface.\n";
+}
+
+// Parses the command line into `options`, printing the usage on a bad argument
+bool parseHeadlessOptions(int argc, char* argv[], HeadlessOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool valid = true;
+        if ((arg == "--render" || arg == "--video") && hasValue && options.output.empty()) {
+            options.output = argv[++i];
+            options.video = arg == "--video";
+        }
+        else if (arg == "--bench") {
+            options.bench = true;
+        }
+        else if (arg == "--repeats" && hasValue) {
+            options.repeats = std::atoi(argv[++i]);
+            valid = options.repeats > 0;
+        }
+        else if (arg == "--farm" && hasValue) {
+            options.farm = argv[++i];
+        }
+        else if (arg == "--worker" && hasValue) {
+            options.workerPort = std::atoi(argv[++i]);
+            valid = options.workerPort > 0 && options.workerPort < 65536;
+        }
+        else if (arg == "--bind" && hasValue) {
+            options.bindAddress = argv[++i];
+        }
+        else if (arg == "--secret" && hasValue) {
+            options.secret = argv[++i];
+        }
+        else if (arg == "--path" && hasValue) {
+            options.pathFile = argv[++i];
+        }
+        else if (arg == "--sequence" && hasValue) {
+            options.sequence = std::atoi(argv[++i]);
+            valid = options.sequence > 0;
+        }
+        else if (arg == "--octave-frames" && hasValue) {
+            options.octaveFrames = std::atoi(argv[++i]);
+            valid = options.octaveFrames > 0;
+        }
+        else if (arg == "--size" && hasValue) {
+            valid = std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) == 2 && options.width > 0 && options.height > 0;
+        }
+        else if (arg == "--center" && i + 2 < argc) {
+            valid = BigFloat::parse(argv[i + 1], options.centerX) && BigFloat::parse(argv[i + 2], options.centerY);
+            i += 2;
+        }
+        else if (arg == "--width" && hasValue) {
+            valid = FloatExp::parse(argv[++i], options.viewWidth) && options.viewWidth.mantissa > 0.0;
+        }
+        else if (arg == "--iterations" && hasValue) {
+            const std::string value = argv[++i];
+            options.iterations = value == "auto" ? 0 : std::atoi(value.c_str());
+            valid = value == "auto" || options.iterations > 0;
+        }
+        else if (arg == "--kernel" && hasValue) {
+            const std::string name = argv[++i];
+            valid = false;
+            for (int k = 0; k < KERNEL_COUNT; ++k) {
+                if (name == kernelNames[k] && isKernelSupported(k)) {
+                    selectedKernel.store(k);
+                    valid = true;
+                }
+            }
+        }
+        else if (arg == "--threads" && hasValue) {
+            options.threads = std::atoi(argv[++i]);
+            valid = options.threads > 0;
+        }
+        else if (arg == "--affinity" && hasValue) {
+            const std::string name = argv[++i];
+            valid = false;
+            for (int a = 0; a < AFFINITY_COUNT; ++a) {
+                if (name == affinityNames[a]) {
+                    options.affinity = a;
+                    valid = true;
+                }
+            }
+        }
+        else if (arg == "--backend" && hasValue) {
+            const std::string name = argv[++i];
+            valid = false;
+            for (int b = 0; b < BACKEND_COUNT; ++b) {
+                if (name == backendNames[b]) {
+                    selectedBackend.store(b);
+                    valid = true;
+                }
+            }
+        }
+        else if (arg == "--precision" && hasValue) {
+            const std::string name = argv[++i];
+            valid = false;
+            for (int p = 0; p < PRECISION_COUNT; ++p) {
+                if (name == precisionNames[p]) {
+                    forcedPrecision.store(p);
+                    valid = true;
+                }
+            }
+        }
+        else if (arg == "--gradient" && hasValue) {
+            valid = loadGradient(argv[++i]);
+        }
+        else if (arg == "--grayscale") {
+            options.color = false;
+        }
+        else if (arg == "--smooth") {
+            options.smooth = true;
+        }
+        else if (arg == "--distance") {
+            options.distance = true;
+        }
+        else if (arg == "--antialias" && hasValue) {
+            options.samples = std::atoi(argv[++i]);
+            valid = options.samples == 4 || options.samples == 16;
+        }
+        else if (arg == "--subdivide") {
+            options.subdivide = true;
+        }
+        else if (arg == "--no-perturbation") {
+            options.perturbation = false;
+        }
+        else if (arg == "--no-series") {
+            options.series = false;
+        }
+        else if (arg == "--formula" && hasValue) {
+            const std::string name = argv[++i];
+            valid = false;
+            for (int f = 0; f < FORMULA_COUNT; ++f) {
+                if (name == formulaNames[f]) {
+                    options.formula = f;
+                    valid = true;
+                }
+            }
+        }
+        else if (arg == "--julia" && i + 2 < argc) {
+            options.formula = FORMULA_JULIA;
+            options.juliaX = std::atof(argv[i + 1]);
+            options.juliaY = std::atof(argv[i + 2]);
+            i += 2;
+        }
+        else {
+            valid = false;
+        }
+
+        if (!valid) {
+            std::cerr << "Invalid argument: " << arg << "\n";
+            printHeadlessUsage();
+            return false;
+        }
+    }
+    if (options.workerPort == 0 && (options.bench ? !options.output.empty() : options.output.empty() || options.video == options.pathFile.empty())) {
+        printHeadlessUsage();
+        return false;
+    }
+    return true;
+}
+
+// View with the engine and color settings of the options; the caller fills in the geometry,
+// precision and iteration limit
+ViewSnapshot headlessView(const HeadlessOptions& options) {
+    ViewSnapshot view;
+    view.panX = 0;
+    view.panY = 0;
+    view.kernel = selectedKernel.load();
+    view.backend = selectedBackend.load();
+    view.formula = options.formula;
+    view.juliaX = options.juliaX;
+    view.juliaY = options.juliaY;
+    view.perturbation = options.perturbation && options.formula == FORMULA_MANDELBROT;
+    view.series = options.series;
+    view.distance = options.distance && options.formula == FORMULA_MANDELBROT;
+    view.samples = view.distance ? 1 : options.samples;
+    view.progressive = false;
+    view.subdivide = options.subdivide && formulaConnected[options.formula];
+    view.color = options.color;
+    view.gradient = options.color && gradientVersion.load() > 0;
+    view.smooth = options.smooth;
+    return view;
+}
+
+// Render farm. "--worker <port>" turns a machine into a worker, and "--farm <host:port>,..." has
+// the stills and videos of the coordinator computed by those workers. Frames are split into jobs
+// of one row of the pool's tiles across the whole width, which the workers pull over TCP as they
+// finish earlier ones, so a slow node simply takes fewer jobs. Each worker receives a frame's
+// geometry once and jobs name it by ID, so its reference orbit stays cached between jobs and is
+// extended when the limit rises. Results come back as run-length coded counts, plus the fractions
+// of escaped pixels when coloring is smooth or by distance. The jobs of a worker that disconnects
+// go to the others, as do those of a worker that sends no result within FARM_JOB_TIMEOUT_MS;
+// once none are left, the coordinator computes the frame itself.
+// A worker listens on 127.0.0.1 unless told otherwise, and serves only a coordinator whose hello
+// carries its secret. The secret travels in the clear: it keeps stray peers out of a trusted
+// network, it does not make an untrusted one safe. Whatever a peer sends stays within the limits
+// below, so no message can make a worker allocate more than one strip of the widest frame.
+const uint32_t FARM_PROTOCOL_VERSION = 5;
+const int FARM_JOBS_IN_FLIGHT = 2; // Jobs queued per worker, so it starts the next while the last result travels
+const int FARM_MAX_WIDTH = 32768;  // Widest and tallest frame the farm computes; larger ones stay local
+const int FARM_MAX_HEIGHT = 32768;
+// The largest result, a strip of FARM_MAX_WIDTH x TILE_SIZE pixels at no more than 10 bytes each:
+// a one-byte run, a count difference of up to 5 bytes and a fraction. Every other message is smaller.
+const uint32_t FARM_MAX_MESSAGE = FARM_MAX_WIDTH * TILE_SIZE * 10 + 64;
+const int FARM_HELLO_TIMEOUT_MS = 5000; // How long a worker waits for a new connection's hello
+const int FARM_JOB_TIMEOUT_MS = 60000;  // How long a coordinator waits for a job's result before dropping the worker
+// How long a worker waits on a greeted coordinator before serving the next one. Within a frame
+// jobs follow each other closely; this allows for a coordinator busy between frames.
+const int FARM_IDLE_TIMEOUT_MS = 600000;
+
+enum FarmMessage : uint8_t { FARM_HELLO, FARM_VIEW, FARM_JOB, FARM_RESULT };
+
+bool sendAll(SOCKET socket, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        const int sent = send(socket, reinterpret_cast<const char*>(data), static_cast<int>(std::min<size_t>(size, 1 << 20)), 0);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool receiveAll(SOCKET socket, uint8_t* data, size_t size) {
+    while (size > 0) {
+        const int received = recv(socket, reinterpret_cast<char*>(data), static_cast<int>(std::min<size_t>(size, 1 << 20)), 0);
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+// Bounds every later blocking send and receive on the socket; 0 waits forever
+void setSocketTimeout(SOCKET socket, int milliseconds) {
+    const DWORD timeout = milliseconds;
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+// Compares in a time that does not depend on where the secrets differ
+bool sameSecret(const std::string& a, const std::string& b) {
+    unsigned char difference = a.size() != b.size();
+    for (size_t i = 0; i < std::min(a.size(), b.size()); ++i) {
+        difference |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return difference == 0;
+}
+
+// A message is its length, its type and the payload
+bool sendMessage(SOCKET socket, FarmMessage type, const WireWriter& payload) {
+    WireWriter header;
+    header.put(static_cast<uint32_t>(payload.bytes.size() + 1));
+    header.put(static_cast<uint8_t>(type));
+    return sendAll(socket, header.bytes.data(), header.bytes.size()) && sendAll(socket, payload.bytes.data(), payload.bytes.size());
+}
+
+bool receiveMessage(SOCKET socket, FarmMessage& type, std::vector<uint8_t>& payload) {
+    uint32_t length = 0;
+    uint8_t kind = 0;
+    if (!receiveAll(socket, reinterpret_cast<uint8_t*>(&length), sizeof(length)) || length == 0 || length > FARM_MAX_MESSAGE ||
+        !receiveAll(socket, &kind, 1)) {
+        return false;
+    }
+    type = static_cast<FarmMessage>(kind);
+    payload.resize(length - 1);
+    return receiveAll(socket, payload.data(), payload.size());
+}
+
+// Coordinator side: one connection per worker, and during each frame one thread per worker
+// feeding it jobs from the shared queue
+class RenderFarm {
+public:
+    ~RenderFarm() {
+        for (Worker& worker : workers) {
+            if (worker.socket != INVALID_SOCKET) {
+                closesocket(worker.socket);
+            }
+        }
+    }
+
+    // Connects to the comma-separated "host:port" workers that share the secret; returns how many answered
+    int connect(const std::string& addresses, const std::string& secret) {
+        std::istringstream list(addresses);
+        std::string address;
+        while (std::getline(list, address, ',')) {
+            const size_t colon = address.rfind(':');
+            Worker worker;
+            worker.address = address;
+            if (colon != std::string::npos) {
+                worker.socket = connectTo(address.substr(0, colon), address.substr(colon + 1), secret);
+            }
+            if (worker.socket == INVALID_SOCKET) {
+                std::cerr << "Cannot reach worker " << address << ", or it has another protocol version or secret\n";
+                continue;
+            }
+            workers.push_back(worker);
+        }
+        return static_cast<int>(workers.size());
+    }
+
+    // Fills the buffers for the view; false if every worker was lost before the frame was done.
+    // The rows of a job are a panned view of the frame, like the bands of a still, which needs
+    // an even frame height.
+    bool compute(const ViewSnapshot& view) {
+        if (view.height % 2 != 0 || view.width > FARM_MAX_WIDTH || view.height > FARM_MAX_HEIGHT) {
+            return false;
+        }
+        if (viewId == 0 || !(sameCoordinates(view, lastView) && view.panX == lastView.panX && view.panY == lastView.panY &&
+            view.smooth == lastView.smooth && view.distance == lastView.distance)) {
+            ++viewId;
+            lastView = view;
+        }
+        sizeBuffers(view.width, view.height);
+        bufferMaxIter = view.maxIter;
+        resumableFrame.valid = false;
+
+        pending.clear();
+        for (int y0 = 0; y0 < view.height; y0 += TILE_SIZE) {
+            pending.push_back(y0);
+        }
+        remaining = static_cast<int>(pending.size());
+
+        // A round ends once the queue is empty; lost workers leave theirs to another round
+        while (remaining > 0) {
+            std::vector<std::thread> threads;
+            for (Worker& worker : workers) {
+                if (worker.socket != INVALID_SOCKET) {
+                    threads.emplace_back([this, &worker, &view] { serve(worker, view); });
+                }
+            }
+            if (threads.empty()) {
+                return false;
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Worker {
+        std::string address;
+        SOCKET socket = INVALID_SOCKET;
+        uint32_t view = 0; // ID of the view the worker holds
+    };
+
+    static SOCKET connectTo(const std::string& host, const std::string& port, const std::string& secret) {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0) {
+            return INVALID_SOCKET;
+        }
+
+        SOCKET connection = INVALID_SOCKET;
+        for (addrinfo* candidate = found; candidate && connection == INVALID_SOCKET; candidate = candidate->ai_next) {
+            connection = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+            if (connection != INVALID_SOCKET && ::connect(connection, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) != 0) {
+                closesocket(connection);
+                connection = INVALID_SOCKET;
+            }
+        }
+        freeaddrinfo(found);
+        if (connection == INVALID_SOCKET) {
+            return INVALID_SOCKET;
+        }
+
+        // Jobs are small messages that should leave at once. A worker that stalls without
+        // disconnecting times out like one that is lost, so its jobs go to the others.
+        const int noDelay = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        setSocketTimeout(connection, FARM_JOB_TIMEOUT_MS);
+
+        WireWriter hello;
+        hello.put(FARM_PROTOCOL_VERSION);
+        hello.putString(secret);
+        FarmMessage type;
+        std::vector<uint8_t> payload;
+        if (!sendMessage(connection, FARM_HELLO, hello) || !receiveMessage(connection, type, payload) || type != FARM_HELLO) {
+            closesocket(connection);
+            return INVALID_SOCKET;
+        }
+        WireReader reply(payload);
+        if (reply.get<uint32_t>() != FARM_PROTOCOL_VERSION || !reply.ok) {
+            closesocket(connection);
+            return INVALID_SOCKET;
+        }
+        return connection;
+    }
+
+    // Keeps the worker FARM_JOBS_IN_FLIGHT jobs ahead until the queue runs dry. Results arrive
+    // in the order the jobs were sent, as a worker computes one job at a time, so each receive
+    // waits for one job and the socket timeout bounds every job at FARM_JOB_TIMEOUT_MS.
+    void serve(Worker& worker, const ViewSnapshot& view) {
+        bool ok = true;
+        if (worker.view != viewId) {
+            WireWriter message;
+            message.put(viewId);
+            message.putBigFloat(view.centerX);
+            message.putBigFloat(view.centerY);
+            message.putFloatExp(view.viewWidth);
+            message.putFloatExp(view.viewHeight);
+            message.put(static_cast<int32_t>(view.width));
+            message.put(static_cast<int32_t>(view.height));
+            message.put(static_cast<int64_t>(view.panX));
+            message.put(static_cast<int64_t>(view.panY));
+            const uint8_t flags = (view.perturbation ? 1 : 0) | (view.series ? 2 : 0) | (view.subdivide ? 4 : 0) | (view.smooth ? 8 : 0) | (view.distance ? 16 : 0);
+            message.put(flags);
+            message.put(static_cast<uint8_t>(view.samples));
+            message.put(static_cast<uint8_t>(view.formula));
+            message.put(view.juliaX);
+            message.put(view.juliaY);
+            ok = sendMessage(worker.socket, FARM_VIEW, message);
+            worker.view = viewId;
+        }
+
+        std::deque<int> inFlight;
+        auto refill = [&]() {
+            while (ok && static_cast<int>(inFlight.size()) < FARM_JOBS_IN_FLIGHT) {
+                int y0;
+                {
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    if (pending.empty()) {
+                        return;
+                    }
+                    y0 = pending.front();
+                    pending.pop_front();
+                }
+                inFlight.push_back(y0);
+
+                WireWriter job;
+                job.put(viewId);
+                job.put(static_cast<int32_t>(y0));
+                job.put(static_cast<int32_t>(std::min(TILE_SIZE, view.height - y0)));
+                job.put(static_cast<int32_t>(view.maxIter));
+                job.put(static_cast<int32_t>(view.precision));
+                ok = sendMessage(worker.socket, FARM_JOB, job);
+            }
+            };
+
+        refill();
+        while (ok && !inFlight.empty()) {
+            const int y0 = inFlight.front();
+            const int rows = std::min(TILE_SIZE, view.height - y0);
+            FarmMessage type;
+            std::vector<uint8_t> payload;
+            ok = receiveMessage(worker.socket, type, payload) && type == FARM_RESULT;
+            if (ok) {
+                WireReader in(payload);
+                ok = in.get<int32_t>() == y0 && in.get<int32_t>() == rows && decodeRows(in, y0, rows, view.width, view.maxIter, view.smooth || view.distance);
+            }
+            if (ok) {
+                inFlight.pop_front();
+                --remaining;
+                refill();
+            }
+        }
+
+        if (!ok) {
+            std::cerr << "Lost worker " << worker.address << ": disconnected or timed out\n";
+            closesocket(worker.socket);
+            worker.socket = INVALID_SOCKET;
+            std::lock_guard<std::mutex> lock(queueMutex);
+            pending.insert(pending.end(), inFlight.begin(), inFlight.end());
+        }
+    }
+
+    std::vector<Worker> workers;
+    ViewSnapshot lastView;
+    uint32_t viewId = 0;
+    std::mutex queueMutex;
+    std::deque<int> pending;     // First rows of the jobs not handed out yet
+    std::atomic<int> remaining{ 0 }; // Jobs whose results have not been stored
+};
+
+RenderFarm* renderFarm = nullptr; // Set by renderHeadless() with --farm
+
+// Fills the buffers for a headless view, on the farm if there is one
+void computeHeadless(const ViewSnapshot& view) {
+    if (!renderFarm || !renderFarm->compute(view)) {
+        computeIterations(view, [] { return false; }, [] {});
+    }
+}
+
+// Serves one coordinator until it disconnects, sends something malformed or stays silent for
+// FARM_IDLE_TIMEOUT_MS, since the next coordinator waits meanwhile. Nothing but a hello with the
+// right secret is accepted first, and that has to arrive within FARM_HELLO_TIMEOUT_MS.
+void serveCoordinator(SOCKET connection, const HeadlessOptions& options) {
+    ViewSnapshot frame = headlessView(options);
+    uint32_t viewId = 0;
+    bool greeted = false;
+    FarmMessage type;
+    std::vector<uint8_t> payload;
+    setSocketTimeout(connection, FARM_HELLO_TIMEOUT_MS);
+    while (receiveMessage(connection, type, payload)) {
+        WireReader in(payload);
+        WireWriter reply;
+        if (type == FARM_HELLO) {
+            const uint32_t version = in.get<uint32_t>();
+            if (greeted || version != FARM_PROTOCOL_VERSION || !sameSecret(in.getString(), options.secret) || !in.ok) {
+                std::cout << "Refused a coordinator: wrong protocol version or secret\n";
+                return;
+            }
+            reply.put(FARM_PROTOCOL_VERSION);
+            if (!sendMessage(connection, FARM_HELLO, reply)) {
+                return;
+            }
+            greeted = true;
+            setSocketTimeout(connection, FARM_IDLE_TIMEOUT_MS);
+        }
+        else if (!greeted) {
+            return;
+        }
+        else if (type == FARM_VIEW) {
+            viewId = in.get<uint32_t>();
+            frame.centerX = in.getBigFloat();
+            frame.centerY = in.getBigFloat();
+            frame.viewWidth = in.getFloatExp();
+            frame.viewHeight = in.getFloatExp();
+            frame.width = in.get<int32_t>();
+            frame.height = in.get<int32_t>();
+            frame.panX = in.get<int64_t>();
+            frame.panY = in.get<int64_t>();
+            const uint8_t flags = in.get<uint8_t>();
+            frame.perturbation = (flags & 1) != 0;
+            frame.series = (flags & 2) != 0;
+            frame.subdivide = (flags & 4) != 0;
+            frame.smooth = (flags & 8) != 0;
+            frame.distance = (flags & 16) != 0;
+            frame.samples = in.get<uint8_t>();
+            frame.formula = in.get<uint8_t>();
+            frame.juliaX = in.get<double>();
+            frame.juliaY = in.get<double>();
+            if (!in.ok || (frame.samples != 1 && frame.samples != 4 && frame.samples != 16) || frame.formula >= FORMULA_COUNT ||
+                frame.width <= 0 || frame.width > FARM_MAX_WIDTH || frame.height <= 0 || frame.height > FARM_MAX_HEIGHT || frame.height % 2 != 0) {
+                return;
+            }
+            frameCache.clear(); // Jobs of other views never overlap this one's
+        }
+        else if (type == FARM_JOB) {
+            const uint32_t id = in.get<uint32_t>();
+            const int y0 = in.get<int32_t>();
+            const int rows = in.get<int32_t>();
+            const int maxIter = in.get<int32_t>();
+            const int precision = in.get<int32_t>();
+            if (!in.ok || id != viewId || viewId == 0 || y0 < 0 || rows <= 0 || rows > TILE_SIZE || rows > frame.height - y0 || (frame.height - rows) % 2 != 0 ||
+                maxIter <= 0 || maxIter > MAX_DEEP_ITER || precision < 0 || precision >= PRECISION_COUNT) {
+                return;
+            }
+
+            // The rows as a view of their own, panned to where they sit in the frame
+            ViewSnapshot strip = frame;
+            strip.height = rows;
+            strip.viewHeight = frame.viewHeight * (static_cast<double>(rows) / frame.height);
+            strip.panY = frame.panY + y0 + (rows - frame.height) / 2;
+            strip.maxIter = maxIter;
+            strip.precision = precision;
+            computeIterations(strip, [] { return false; }, [] {});
+
+            reply.put(static_cast<int32_t>(y0));
+            reply.put(static_cast<int32_t>(rows));
+            encodeRows(reply, 0, rows, strip.width, maxIter, strip.smooth || strip.distance);
+            if (!sendMessage(connection, FARM_RESULT, reply)) {
+                return;
+            }
+        }
+        else {
+            return;
+        }
+    }
+}
+
+// Serves coordinators on the port of the bind address, one at a time, until the process is stopped
+int runWorker(const HeadlessOptions& options) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* local = nullptr;
+    if (getaddrinfo(options.bindAddress.c_str(), std::to_string(options.workerPort).c_str(), &hints, &local) != 0) {
+        std::cerr << "Cannot resolve the bind address " << options.bindAddress << "\n";
+        return 1;
+    }
+    SOCKET listener = socket(local->ai_family, local->ai_socktype, local->ai_protocol);
+    const bool listening = listener != INVALID_SOCKET && bind(listener, local->ai_addr, static_cast<int>(local->ai_addrlen)) == 0 &&
+        listen(listener, 1) == 0;
+    freeaddrinfo(local);
+    if (!listening) {
+        std::cerr << "Cannot listen on " << options.bindAddress << " port " << options.workerPort << "\n";
+        if (listener != INVALID_SOCKET) {
+            closesocket(listener);
+        }
+        return 1;
+    }
 
-std::atomic<bool> running(true);
-std::atomic<int> currentMaxIter(BASE_ITER);
-std::atomic<bool> useColor(true); // Default to color mode
+    std::cout << "Worker listening on " << options.bindAddress << " port " << options.workerPort << ", " << kernelNames[selectedKernel.load()] << " kernel"
+        << (selectedBackend.load() == BACKEND_GPU && gpuBackend().supports(PRECISION_FLOAT) ? " and gpu\n" : "\n");
+    while (true) {
+        SOCKET connection = accept(listener, nullptr, nullptr);
+        if (connection == INVALID_SOCKET) {
+            continue;
+        }
+        const int noDelay = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        std::cout << "Coordinator connected\n";
+        serveCoordinator(connection, options);
+        closesocket(connection);
+        std::cout << "Coordinator disconnected\n";
+    }
+}
 
-long double xMin = -2.0, xMax = 1.0;
-long double yMin = -1.5, yMax = 1.5;
+// Renders one still without opening a window; returns the exit code
+int renderStill(const HeadlessOptions& options) {
+    const int width = options.width, height = options.height;
+    const bool png = options.output.size() < 4 || options.output.substr(options.output.size() - 4) != ".raw";
+    ImageWriter writer;
+    if (!writer.open(options.output, width, height, png)) {
+        std::cerr << "Cannot write " << options.output << "\n";
+        return 1;
+    }
 
-long double initialXMin = -2.0, initialXMax = 1.0;
-long double initialYMin = -1.5, initialYMax = 1.5;
+    // Bands are panned views of the frame; an even frame height keeps every band's pan a whole
+    // number of pixels, and the extra row of an odd frame is never written
+    const FloatExp spacing = options.viewWidth * (1.0 / width);
+    const int evenHeight = height + (height & 1);
+    ViewSnapshot band = headlessView(options);
+    band.centerX = options.centerX;
+    band.centerY = options.centerY;
+    band.viewWidth = options.viewWidth;
+    band.width = width;
+    band.precision = choosePrecision(spacing);
+    const int cap = iterationCap(band.precision, band.perturbation);
+    band.maxIter = options.iterations > 0 ? std::min(options.iterations, cap) : adaptiveMaxIter(EscapeStats(), options.viewWidth, 1.0, cap);
 
-HWND hwnd = nullptr;
+    std::cout << "Rendering " << width << "x" << height << " at " << band.maxIter << " iterations, "
+        << precisionNames[band.precision] << " precision, " << (usesGpu(band) ? "gpu" : kernelNames[band.kernel]) << " kernel\n";
 
-std::vector<COLORREF> pixelBuffer(WIDTH* HEIGHT); // Off-screen pixel buffer
+    std::vector<COLORREF> rowPixels(width);
+    std::vector<uint8_t> rgb;
+    int reported = 0;
+    for (int y0 = 0; y0 < height; y0 += STILL_BAND_ROWS) {
+        const int rows = std::min(STILL_BAND_ROWS, evenHeight - y0);
+        band.height = rows;
+        band.viewHeight = spacing * static_cast<double>(rows);
+        band.panY = y0 + (rows - evenHeight) / 2;
+        computeHeadless(band);
 
-// Function to calculate the color based on iteration count and max iterations
-COLORREF getColor(int iterations, int maxIter) {
-    if (iterations == maxIter) {
-        return RGB(0, 0, 0);  // Black for points inside the set
-    }
+        const int written = std::min(rows, height - y0);
+        const COLORREF* palette = currentPalette(band.maxIter, band.color, band.gradient).colors.data();
+        rgb.resize(static_cast<size_t>(width) * 3 * written);
+        for (int row = 0; row < written; ++row) {
+            const int offset = row * bufferStride;
+            colorKernelFor(band)(iterationBuffer.data() + offset, smoothBuffer.data() + offset, width, palette, band.maxIter, band.smooth, rowPixels.data());
+            uint8_t* target = rgb.data() + static_cast<size_t>(row) * width * 3;
+            for (int px = 0; px < width; ++px) {
+                target[3 * px] = GetRValue(rowPixels[px]);
+                target[3 * px + 1] = GetGValue(rowPixels[px]);
+                target[3 * px + 2] = GetBValue(rowPixels[px]);
+            }
+        }
+        writer.writeRows(rgb.data(), written);
 
-    double t = static_cast<double>(iterations) / maxIter;
+        const int percent = static_cast<int>(100LL * (y0 + written) / height);
+        if (percent >= reported + 10 || y0 + written == height) {
+            reported = percent;
+            std::cout << "  " << percent << "%\n";
+        }
+    }
 
-    if (useColor.load()) {
-        // Color mode
-        int r = static_cast<int>(9 * (1 - t) * t * t * t * 255);
-        int g = static_cast<int>(15 * (1 - t) * (1 - t) * t * t * 255);
-        int b = static_cast<int>(8.5 * (1 - t) * (1 - t) * (1 - t) * t * 255);
+    if (!writer.close()) {
+        std::cerr << "Failed writing " << options.output << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << options.output << "\n";
+    return 0;
+}
 
-        // Dynamically adjust the color intensity based on the iteration count
-        int maxColorValue = 255;
-        r = (r > maxColorValue) ? maxColorValue : r;
-        g = (g > maxColorValue) ? maxColorValue : g;
-        b = (b > maxColorValue) ? maxColorValue : b;
+// Zoom videos. Keyframes are computed at KEYFRAME_SCALE times the frame size each time the view
+// width halves, and every frame in between is resampled from the two keyframes around it: the
+// wider one covers the whole frame and the narrower one replaces it wherever it reaches, so no
+// frame is ever upsampled. Only two keyframes are held at a time.
+const int KEYFRAME_SCALE = 2;
+const int ENCODE_QUEUE_FRAMES = 4; // Finished frames that may wait for the encoder before rendering stalls
 
-        return RGB(r, g, b);
+// Reads zoom sequence `sequence` (counting from 1) of a path file. A line holds "x y width", or
+// is a center the viewer logged after a click, "(x, y)", which zooms 10x into the previous view.
+// A sequence ends where the width stops shrinking or a click lands outside the previous view;
+// logged sequences start from the initial view, as the viewer does.
+bool loadZoomPath(const std::string& file, int sequence, std::vector<PathPoint>& points) {
+    std::ifstream in(file);
+    if (!in) {
+        return false;
     }
-    else {
-        // Grayscale mode
-        int gray = static_cast<int>(255 * t);
-        return RGB(gray, gray, gray);  // Return grayscale color
+
+    const PathPoint initial = { BigFloat(initialCenterX), BigFloat(initialCenterY), FloatExp(initialViewWidth) };
+    auto magnitude = [](FloatExp value) { return FloatExp(std::fabs(value.mantissa), value.exponent); };
+    int current = 1;
+    points.clear();
+    std::string line;
+    while (std::getline(in, line)) {
+        std::replace_if(line.begin(), line.end(), [](char c) { return c == '(' || c == ')' || c == ','; }, ' ');
+        std::istringstream words(line);
+        std::string word;
+        PathPoint point = initial;
+        int numbers = 0;
+        while (numbers < 3 && words >> word) {
+            if (numbers < 2 ? BigFloat::parse(word, numbers == 0 ? point.x : point.y) : FloatExp::parse(word, point.width)) {
+                ++numbers;
+            }
+        }
+        if (numbers < 2) {
+            continue;
+        }
+
+        bool restart;
+        if (numbers == 2) {
+            // Within a view width either way, which allows for non-square windows and rounded logs
+            const PathPoint& previous = points.empty() ? initial : points.back();
+            restart = !points.empty() && (previous.width < magnitude((point.x - previous.x).toFloatExp()) ||
+                previous.width < magnitude((point.y - previous.y).toFloatExp()));
+            point.width = (restart ? initial : previous).width * 0.1;
+        }
+        else {
+            restart = !points.empty() && !(point.width < points.back().width);
+        }
+        if (restart) {
+            if (current == sequence) {
+                break;
+            }
+            ++current;
+            points.clear();
+        }
+        if (points.empty() && numbers == 2) {
+            points.push_back(initial);
+        }
+        points.push_back(point);
     }
+    return current == sequence && points.size() >= 2;
 }
 
-void drawMandelbrot(HDC hdc) {
-    const int numThreads = std::thread::hardware_concurrency(); // Get number of available cores
-    const int rowsPerThread = HEIGHT / numThreads;
+// Writes video frames as numbered PNG files on its own thread, so encoding overlaps rendering
+class FrameEncoder {
+public:
+    FrameEncoder(const std::string& prefix, int width, int height)
+        : prefix(prefix), width(width), height(height), worker([this] { run(); }) {}
 
-    auto drawRegion = [&](int startRow, int endRow) {
-        for (int px = 0; px < WIDTH; ++px) {
-            for (int py = startRow; py < endRow; ++py) {
-                long double x0 = xMin + (xMax - xMin) * px / WIDTH;
-                long double y0 = yMin + (yMax - yMin) * py / HEIGHT;
+    // Queues the next frame's top-down RGB rows, waiting while ENCODE_QUEUE_FRAMES are pending
+    void push(std::vector<uint8_t> rgb) {
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this] { return queue.size() < ENCODE_QUEUE_FRAMES; });
+        queue.push_back(std::move(rgb));
+        work.notify_one();
+    }
 
-                std::complex<long double> c(x0, y0);
-                std::complex<long double> z(0, 0);
-                int iterations = 0;
+    // Writes the frames still queued and stops; false if any file failed
+    bool finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        work.notify_one();
+        worker.join();
+        return !failed;
+    }
 
-                int dynamicMaxIter = currentMaxIter.load();
-                while (std::abs(z) <= 2.0 && iterations < dynamicMaxIter) {
-                    z = z * z + c;
-                    ++iterations;
+private:
+    void run() {
+        for (int index = 0;; ++index) {
+            std::vector<uint8_t> rgb;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work.wait(lock, [this] { return !queue.empty() || done; });
+                if (queue.empty()) {
+                    return;
                 }
+                rgb = std::move(queue.front());
+                queue.pop_front();
+            }
+            space.notify_one();
 
-                // Use the getColor function to calculate the appropriate color for this point
-                COLORREF color = getColor(iterations, dynamicMaxIter);
-
-                pixelBuffer[py * WIDTH + px] = color;
+            char number[16];
+            std::snprintf(number, sizeof(number), "%05d", index);
+            ImageWriter writer;
+            if (writer.open(prefix + number + ".png", width, height, true)) {
+                writer.writeRows(rgb.data(), height);
+                failed = !writer.close() || failed;
+            }
+            else {
+                failed = true;
             }
         }
+    }
+
+    const std::string prefix;
+    const int width, height;
+    std::mutex mutex;
+    std::condition_variable work, space;
+    std::deque<std::vector<uint8_t>> queue; // Guarded by mutex
+    bool done = false;                      // Guarded by mutex
+    bool failed = false;                    // Only the worker writes it before finish() joins
+    std::thread worker;
+};
+
+// Iteration counts of one keyframe, at the zoom path's last center panned by (panX, panY)
+struct Keyframe {
+    FloatExp width, spacing;
+    long long panX = 0, panY = 0;
+    int maxIter = 0;
+    int stride = 0;
+    AlignedVector<int> iterations;
+    AlignedVector<float> fractions;
+};
+
+// Renders a zoom along a path file as numbered PNG frames; returns the exit code
+int renderVideo(const HeadlessOptions& options) {
+    std::vector<PathPoint> path;
+    if (!loadZoomPath(options.pathFile, options.sequence, path)) {
+        std::cerr << "No zoom sequence " << options.sequence << " in " << options.pathFile << "\n";
+        return 1;
+    }
+
+    // Between two path points the camera zooms towards the point that stays put going from one
+    // view to the other, as a click does, so every view lies within the wider views before it.
+    // Positions are kept relative to the last center, where every keyframe is anchored, so the
+    // deep keyframes share one reference orbit and pan towards the camera instead.
+    const PathPoint& target = path.back();
+    std::vector<FloatExp> pointX, pointY;
+    for (const PathPoint& point : path) {
+        pointX.push_back((point.x - target.x).toFloatExp());
+        pointY.push_back((point.y - target.y).toFloatExp());
+    }
+    auto ratio = [](FloatExp a, FloatExp b) { return (a * FloatExp(1.0 / b.mantissa, -b.exponent)).toDouble(); };
+    auto cameraAt = [&](FloatExp span, FloatExp& x, FloatExp& y) {
+        size_t i = 0;
+        while (i + 2 < path.size() && span < path[i + 1].width) {
+            ++i;
+        }
+        const double s = std::min(std::max(ratio(path[i].width - span, path[i].width - path[i + 1].width), 0.0), 1.0);
+        x = pointX[i] * (1.0 - s) + pointX[i + 1] * s;
+        y = pointY[i] * (1.0 - s) + pointY[i + 1] * s;
+    };
+
+    const int width = options.width, height = options.height;
+    const int keyWidth = KEYFRAME_SCALE * width, keyHeight = KEYFRAME_SCALE * height;
+    const double octaves = path.front().width.log2() - target.width.log2();
+    if (!(octaves > 0.0)) {
+        std::cerr << "The zoom path does not zoom in\n";
+        return 1;
+    }
+    const int keyCount = static_cast<int>(std::ceil(octaves - 1e-9)) + 1;
+    const int frameCount = static_cast<int>(std::ceil(octaves * options.octaveFrames - 1e-9)) + 1;
+    auto widthAt = [&](double octave) {
+        const double whole = std::floor(octave);
+        return octave >= octaves ? target.width : path.front().width * FloatExp(std::exp2(whole - octave), -static_cast<int>(whole));
+    };
+
+    ViewSnapshot base = headlessView(options);
+    base.centerX = target.x;
+    base.centerY = target.y;
+    base.width = keyWidth;
+    base.height = keyHeight;
+
+    // The deepest keyframe needs the most precision, so its orbit, computed up front, serves all
+    // the others; limits raised past it later only extend it
+    const FloatExp deepestSpacing = target.width * (1.0 / keyWidth);
+    const int deepestPrecision = choosePrecision(deepestSpacing);
+    if (deepestPrecision == PRECISION_BIGNUM && base.perturbation) {
+        const int cap = iterationCap(deepestPrecision, true);
+        const int limit = options.iterations > 0 ? std::min(options.iterations, cap) : adaptiveMaxIter(EscapeStats(), target.width, 1.0, cap);
+        getReferenceOrbit(target.x, target.y, bigFloatPrecisionFor(deepestSpacing), limit);
+    }
+
+    std::cout << "Rendering " << frameCount << " frames of " << width << "x" << height << " from " << keyCount
+        << " keyframes, " << kernelNames[base.kernel] << " kernel\n";
+
+    EscapeStats stats;
+    auto renderKeyframe = [&](int index, Keyframe& key) {
+        key.width = widthAt(index);
+        key.spacing = key.width * (1.0 / keyWidth);
+        FloatExp x, y;
+        cameraAt(key.width, x, y);
+        key.panX = std::llround(ratio(x, key.spacing));
+        key.panY = std::llround(ratio(y, key.spacing));
+
+        ViewSnapshot view = base;
+        view.panX = key.panX;
+        view.panY = key.panY;
+        view.viewWidth = key.width;
+        view.viewHeight = key.spacing * static_cast<double>(keyHeight);
+        view.precision = choosePrecision(key.spacing);
+        const int cap = iterationCap(view.precision, view.perturbation);
+        const double zoomStep = index == 0 ? 1.0 : ratio(widthAt(index - 1), key.width);
+        view.maxIter = options.iterations > 0 ? std::min(options.iterations, cap) : adaptiveMaxIter(stats, key.width, zoomStep, cap);
+
+        // As in the viewer, a limit that still cuts the boundary off doubles and resumes
+        computeHeadless(view);
+        stats = measureEscapes(keyWidth, keyHeight, view.maxIter);
+        while (options.iterations == 0 && stats.lateShare > LATE_ESCAPE_SHARE && view.maxIter < cap) {
+            view.maxIter = std::min(2 * view.maxIter, cap);
+            computeHeadless(view);
+            stats = measureEscapes(keyWidth, keyHeight, view.maxIter);
+        }
+
+        key.maxIter = view.maxIter;
+        key.stride = bufferStride;
+        key.iterations = iterationBuffer;
+        key.fractions = smoothBuffer;
+        frameCache.clear(); // No keyframe is revisited, so cached copies would only hold memory
+        std::cout << "Keyframe " << index + 1 << "/" << keyCount << ": width " << key.width.toString() << ", "
+            << key.maxIter << " iterations, " << precisionNames[view.precision] << " precision\n";
+    };
+
+    Keyframe outer, inner;
+    int outerIndex = 0;
+    renderKeyframe(0, outer);
+    if (keyCount > 1) {
+        renderKeyframe(1, inner);
+    }
+
+    FrameEncoder encoder(options.output, width, height);
+    int reported = 0;
+    for (int frame = 0; frame < frameCount; ++frame) {
+        const double octave = std::min(static_cast<double>(frame) / options.octaveFrames, octaves);
+        while (outerIndex < std::min(static_cast<int>(octave), keyCount - 2)) {
+            outer = std::move(inner);
+            ++outerIndex;
+            renderKeyframe(outerIndex + 1, inner);
+        }
+        const bool hasInner = outerIndex + 1 < keyCount;
+
+        const FloatExp span = widthAt(octave);
+        const FloatExp spacing = span * (1.0 / width);
+        FloatExp x, y;
+        cameraAt(span, x, y);
+
+        // Keyframe pixel of frame pixel (fx, fy): (u0 + fx * step, v0 + fy * step)
+        struct Mapping {
+            double u0, v0, step;
+        };
+        auto mapping = [&](const Keyframe& key) {
+            Mapping m;
+            m.step = ratio(spacing, key.spacing);
+            m.u0 = ratio(x, key.spacing) - key.panX + keyWidth / 2.0 - width / 2.0 * m.step;
+            m.v0 = ratio(y, key.spacing) - key.panY + keyHeight / 2.0 - height / 2.0 * m.step;
+            return m;
+        };
+        const Mapping outerMap = mapping(outer);
+        const Mapping innerMap = hasInner ? mapping(inner) : outerMap;
+        const int samples = std::max(1, static_cast<int>(std::ceil((hasInner ? innerMap.step : outerMap.step) - 1e-9)));
+
+        // The palette limit moves geometrically from one keyframe's limit to the next, so colors
+        // do not jump where the inner keyframe takes over; counts the frame's limit does not
+        // reach, and pixels a keyframe left unfinished, are interior
+        const double s = hasInner ? std::min(std::max((outer.width.log2() - span.log2()) / (outer.width.log2() - inner.width.log2()), 0.0), 1.0) : 0.0;
+        const int limit = hasInner ? std::max(1, static_cast<int>(std::lround(outer.maxIter * std::pow(static_cast<double>(inner.maxIter) / outer.maxIter, s)))) : outer.maxIter;
+        const COLORREF* palette = currentPalette(limit, base.color, base.gradient).colors.data();
+        auto shade = [&](const Keyframe& key, size_t index) {
+            const int n = key.iterations[index];
+            if (n >= key.maxIter || n >= limit) {
+                return palette[limit];
+            }
+            if (base.distance) {
+                return distanceColor(palette, limit, key.fractions[index]);
+            }
+            COLORREF color = palette[n];
+            if (base.smooth) {
+                const COLORREF next = palette[std::max(std::min(n + 1, limit - 1), 0)];
+                const float f = key.fractions[index];
+                auto blend = [f](int a, int b) { return static_cast<int>(a + (b - a) * f + 0.5f); };
+                color = RGB(blend(GetRValue(color), GetRValue(next)), blend(GetGValue(color), GetGValue(next)), blend(GetBValue(color), GetBValue(next)));
+            }
+            return color;
         };
 
-    std::vector<std::thread> threads;
-    for (int i = 0; i < numThreads; ++i) {
-        int startRow = i * rowsPerThread;
-        int endRow = (i == numThreads - 1) ? HEIGHT : (i + 1) * rowsPerThread;
-        threads.emplace_back(drawRegion, startRow, endRow);
+        // Each frame pixel averages samples x samples keyframe pixels across its footprint
+        std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+        renderPool->parallelFor(height, [&](int fy) {
+            uint8_t* target = rgb.data() + static_cast<size_t>(fy) * width * 3;
+            for (int fx = 0; fx < width; ++fx) {
+                int r = 0, g = 0, b = 0;
+                for (int sy = 0; sy < samples; ++sy) {
+                    const double py = fy + (sy + 0.5) / samples - 0.5;
+                    for (int sx = 0; sx < samples; ++sx) {
+                        const double px = fx + (sx + 0.5) / samples - 0.5;
+                        long long u = std::llround(innerMap.u0 + px * innerMap.step);
+                        long long v = std::llround(innerMap.v0 + py * innerMap.step);
+                        const Keyframe* key = &inner;
+                        if (!hasInner || u < 0 || v < 0 || u >= keyWidth || v >= keyHeight) {
+                            key = &outer;
+                            u = std::min<long long>(std::max<long long>(std::llround(outerMap.u0 + px * outerMap.step), 0), keyWidth - 1);
+                            v = std::min<long long>(std::max<long long>(std::llround(outerMap.v0 + py * outerMap.step), 0), keyHeight - 1);
+                        }
+                        const COLORREF color = shade(*key, static_cast<size_t>(v) * key->stride + u);
+                        r += GetRValue(color);
+                        g += GetGValue(color);
+                        b += GetBValue(color);
+                    }
+                }
+                const int count = samples * samples;
+                target[3 * fx] = static_cast<uint8_t>((r + count / 2) / count);
+                target[3 * fx + 1] = static_cast<uint8_t>((g + count / 2) / count);
+                target[3 * fx + 2] = static_cast<uint8_t>((b + count / 2) / count);
+            }
+            });
+        encoder.push(std::move(rgb));
+
+        const int percent = static_cast<int>(100LL * (frame + 1) / frameCount);
+        if (percent >= reported + 10 || frame + 1 == frameCount) {
+            reported = percent;
+            std::cout << "  " << percent << "%\n";
+        }
+    }
+
+    if (!encoder.finish()) {
+        std::cerr << "Failed writing frames to " << options.output << "\n";
+        return 1;
     }
+    std::cout << "Wrote " << frameCount << " frames to " << options.output << "00000.png onwards\n";
+    return 0;
+}
 
-    for (auto& t : threads) {
-        t.join();
+// Benchmark views: the initial view, seahorse valley, a view filled by a period-3 bulb where
+// only periodicity checks catch the interior, two click paths from coordinates.txt, and a
+// perturbation zoom
+struct BenchView {
+    const char* name;
+    const char* x;
+    const char* y;
+    const char* width;
+};
+
+const BenchView benchViews[] = {
+    { "initial", "-0.5", "0", "3" },
+    { "seahorse", "-0.7453", "0.1127", "0.01" },
+    { "interior", "-0.1225", "0.7449", "0.08" },
+    { "deep-spiral", "-0.724108522638", "0.286453744416", "3e-12" },
+    { "deep-dendrite", "-0.740860862780", "0.238072330609", "3e-10" },
+    { "perturbation", "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", "1e-29" },
+};
+const int benchIterations[] = { 500, 2000, 8000 };
+
+// Renders every benchmark view at every limit on pools of 1, 2, 4, ... threads and prints one
+// CSV row per configuration; returns the exit code. Every frame starts cold, as after a click:
+// no cached frame, resumable state or reference orbit. Iterations are the sum of the per-pixel
+// counts, so pixels the interior checks or the series skip count as iterated.
+int runBenchmark(const HeadlessOptions& options) {
+    const int width = options.width, height = options.height;
+    std::vector<int> threadCounts;
+    const int hardwareThreads = renderPool->workerCount(); // As placed by --threads and --affinity
+    for (int threads = 1; threads < hardwareThreads; threads *= 2) {
+        threadCounts.push_back(threads);
     }
+    threadCounts.push_back(hardwareThreads);
+
+    std::cout << "view,precision,kernel,iterations,threads,frames,mpixels_per_s,miter_per_s,p50_ms,p90_ms,p99_ms,scaling_efficiency\n";
+    RenderPool* const ownPool = renderPool;
+    for (const BenchView& bench : benchViews) {
+        ViewSnapshot view = headlessView(options);
+        BigFloat::parse(bench.x, view.centerX);
+        BigFloat::parse(bench.y, view.centerY);
+        FloatExp::parse(bench.width, view.viewWidth);
+        view.viewHeight = view.viewWidth * (static_cast<double>(height) / width);
+        view.width = width;
+        view.height = height;
+        view.precision = choosePrecision(view.viewWidth * (1.0 / width));
+
+        for (int limit : benchIterations) {
+            view.maxIter = std::min(limit, iterationCap(view.precision, view.perturbation));
+            double singleThreadMedian = 0.0;
+            for (int threads : threadCounts) {
+                RenderPool pool(threads, options.affinity);
+                renderPool = &pool;
+
+                // One untimed frame faults in the buffers and yields the iteration total
+                std::vector<double> latencies;
+                double iterations = 0.0;
+                for (int frame = 0; frame <= options.repeats; ++frame) {
+                    frameCache.clear();
+                    resumableFrame.valid = false;
+                    {
+                        std::lock_guard<std::mutex> lock(orbitMutex);
+                        cachedOrbit.reset();
+                    }
+
+                    const auto start = std::chrono::steady_clock::now();
+                    computeIterations(view, [] { return false; }, [] {});
+                    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    if (frame == 0) {
+                        for (int py = 0; py < height; ++py) {
+                            const int* row = &iterationBuffer[py * bufferStride];
+                            iterations += std::accumulate(row, row + width, 0.0);
+                        }
+                    }
+                    else {
+                        latencies.push_back(elapsed.count());
+                    }
+                }
+                renderPool = ownPool;
+
+                std::sort(latencies.begin(), latencies.end());
+                auto percentile = [&](double p) {
+                    const size_t rank = static_cast<size_t>(std::ceil(p * latencies.size()));
+                    return latencies[std::max<size_t>(rank, 1) - 1];
+                };
+                const double total = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+                const double median = percentile(0.5);
+                if (threads == 1) {
+                    singleThreadMedian = median;
+                }
 
-    // Once drawing is complete, blit the buffer to the screen
-    HBITMAP hBitmap = CreateBitmap(WIDTH, HEIGHT, 1, 32, pixelBuffer.data());
-    HDC hdcMem = CreateCompatibleDC(hdc);
-    SelectObject(hdcMem, hBitmap);
+                std::cout << bench.name << "," << precisionNames[view.precision] << "," << (usesGpu(view) ? "gpu" : kernelNames[view.kernel]) << ","
+                    << view.maxIter << "," << threads << "," << latencies.size() << std::fixed << std::setprecision(3) << ","
+                    << static_cast<double>(width) * height * latencies.size() / total * 1e-6 << ","
+                    << iterations * latencies.size() / total * 1e-6 << ","
+                    << percentile(0.5) * 1e3 << "," << percentile(0.9) * 1e3 << "," << percentile(0.99) * 1e3 << ","
+                    << singleThreadMedian / (threads * median) << std::defaultfloat << std::endl;
+            }
+        }
+    }
+    return 0;
+}
 
-    BitBlt(hdc, 0, 0, WIDTH, HEIGHT, hdcMem, 0, 0, SRCCOPY);
+// Runs the headless renderer selected by the command line; returns the exit code
+int renderHeadless(int argc, char* argv[]) {
+    renderingThread = true;
+    HeadlessOptions options;
+    if (!parseHeadlessOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.threads > 0 || options.affinity != AFFINITY_THREADS) {
+        renderPool->configure(options.threads, options.affinity);
+    }
+    if (options.bench) {
+        return runBenchmark(options);
+    }
+    if (options.workerPort == 0 && options.farm.empty()) {
+        return options.video ? renderVideo(options) : renderStill(options);
+    }
 
-    DeleteDC(hdcMem);
-    DeleteObject(hBitmap);
+    WSADATA winsock;
+    if (WSAStartup(MAKEWORD(2, 2), &winsock) != 0) {
+        std::cerr << "Cannot start Winsock\n";
+        return 1;
+    }
+    int result = 1;
+    if (options.workerPort > 0) {
+        result = runWorker(options);
+    }
+    else {
+        RenderFarm farm;
+        const int workers = farm.connect(options.farm, options.secret);
+        if (workers > 0) {
+            std::cout << "Connected to " << workers << " workers\n";
+            renderFarm = &farm;
+            result = options.video ? renderVideo(options) : renderStill(options);
+            renderFarm = nullptr;
+        }
+        else {
+            std::cerr << "No workers reachable\n";
+        }
+    }
+    WSACleanup();
+    return result;
 }
 
 void handleUserInput() {
     while (running) {
         std::string command;
-        std::cout << "Enter command (iterations <number>, reset, toggle, quit): " << "\n";
+        std::cout << "Enter command (iterations <number|auto>, reset, load <file> [sequence], goto <n|next|previous>, toggle, palette <classic|gradient|load <file>>, smooth <on|off>, distance <on|off>, progressive <on|off>, diskcache <on|off>, speculation <on|off>, subdivide <on|off>, antialias <off|4|16>, kernel <auto|scalar|avx2|avx512>, backend <cpu|gpu>, precision <auto|float|double|doubledouble|bignum>, perturbation <on|off>, series <on|off>, formula <name> [re im], threads [<n|auto>] [none|cores|threads], stats [on|off], quit): " << "\n";
         std::getline(std::cin, command);
 
-        if (command.find("iterations") != std::string::npos) {
+        if (command == "iterations auto") {
+            const ViewSnapshot view = takeSnapshot();
+            EscapeStats stats;
+            {
+                std::lock_guard<std::mutex> lock(statsMutex);
+                stats = lastEscapeStats;
+            }
+            useAdaptiveIterations.store(true);
+            currentMaxIter.store(adaptiveMaxIter(stats, view.viewWidth, 1.0, iterationCap(view.precision, view.perturbation)));
+            std::cout << "Automatic iterations, starting at " << currentMaxIter.load() << "\n";
+
+            // Redraw the window
+            requestRender(true);
+        }
+        else if (command.find("iterations") != std::string::npos) {
             int newIterations = std::stoi(command.substr(command.find(' ') + 1));
 
-            // Ensure newIterations does not exceed MAX_ITER
-            if (newIterations > MAX_ITER) {
-                newIterations = MAX_ITER;
+            // Ensure newIterations does not exceed the cap for the current depth; a limit below one
+            // would leave the palette without entries
+            const ViewSnapshot view = takeSnapshot();
+            const int cap = iterationCap(view.precision, view.perturbation);
+            if (newIterations > cap) {
+                newIterations = cap;
             }
 
-            currentMaxIter.store(newIterations, std::memory_order_relaxed);
-            std::cout << "Number of iterations set to " << newIterations << "\n";
+            if (newIterations < 1) {
+                std::cout << "The iteration limit must be at least 1.\n";
+            }
+            else {
+                useAdaptiveIterations.store(false);
+                currentMaxIter.store(newIterations, std::memory_order_relaxed);
+                std::cout << "Number of iterations set to " << newIterations << "\n";
 
-            // Debug: Output the updated number of iterations
-            std::cout << "Updated Iterations: " << currentMaxIter.load() << "\n";
+                // Debug: Output the updated number of iterations
+                std::cout << "Updated Iterations: " << currentMaxIter.load() << "\n";
 
-            // Redraw the window
-            InvalidateRect(hwnd, nullptr, TRUE);
+                // Redraw the window
+                requestRender(true);
+            }
         }
         else if (command == "reset") {
-            xMin = initialXMin;
-            xMax = initialXMax;
-            yMin = initialYMin;
-            yMax = initialYMax;
+            {
+                // The initial view spans the initial window; a resized window keeps its pixel spacing
+                std::lock_guard<std::mutex> lock(viewMutex);
+                centerX = BigFloat(initialCenterX);
+                centerY = BigFloat(initialCenterY);
+                panX = 0;
+                panY = 0;
+                zoomHistory.clear();
+                viewWidth = FloatExp(initialViewWidth * frameWidth / WIDTH);
+                viewHeight = FloatExp(initialViewHeight * frameHeight / HEIGHT);
+            }
 
             std::cout << "View reset to initial coordinates.\n";
 
             // Redraw the window
-            InvalidateRect(hwnd, nullptr, TRUE);
+            requestRender(true);
+        }
+        else if (command.rfind("load ", 0) == 0) {
+            std::istringstream words(command.substr(5));
+            std::string file;
+            int sequence = 1;
+            words >> file;
+            if (!(words >> sequence)) {
+                sequence = 1;
+            }
+
+            std::vector<PathPoint> path;
+            if (!loadZoomPath(file, sequence, path)) {
+                std::cout << "No zoom sequence " << sequence << " in " << file << ".\n";
+            }
+            else {
+                {
+                    std::lock_guard<std::mutex> lock(viewMutex);
+                    replayPath = path;
+                    replayStep = 0;
+                }
+                std::cout << "Loaded " << path.size() << " steps from " << file << "; goto <1-" << path.size() << "|next|previous> shows them.\n";
+
+                // Lets the render thread prerender the first step
+                requestRender(false);
+            }
+        }
+        else if (command.rfind("goto", 0) == 0) {
+            const std::string name = command.size() > 5 ? command.substr(5) : "";
+            PathPoint point;
+            int step, steps;
+            {
+                std::lock_guard<std::mutex> lock(viewMutex);
+                steps = static_cast<int>(replayPath.size());
+                step = name == "next" ? replayStep + 1 : name == "previous" ? replayStep - 1 : std::atoi(name.c_str());
+                if (step >= 1 && step <= steps) {
+                    point = replayPath[step - 1];
+                }
+            }
+
+            if (step < 1 || step > steps) {
+                std::cout << (steps == 0 ? "No zoom path loaded; use load <file> [sequence].\n" : "Use goto <1-" + std::to_string(steps) + "|next|previous>.\n");
+            }
+            else {
+                ViewSnapshot view;
+                {
+                    std::lock_guard<std::mutex> lock(viewMutex);
+                    view = replayView(takeSnapshotLocked(), point);
+                    zoomHistory.push_back({ centerX, centerY, panX, panY, viewWidth, viewHeight, currentMaxIter.load() });
+                    centerX = view.centerX;
+                    centerY = view.centerY;
+                    panX = 0;
+                    panY = 0;
+                    viewWidth = view.viewWidth;
+                    viewHeight = view.viewHeight;
+                    replayStep = step;
+                    currentMaxIter.store(view.maxIter);
+                }
+
+                const int digits = 6 + std::max(6, static_cast<int>(-view.viewWidth.log2() * 0.30103));
+                std::cout << "Step " << step << " of " << steps << ": center (" << view.centerX.toString(digits) << ", " << view.centerY.toString(digits)
+                    << "), width " << view.viewWidth.toString() << ", " << view.maxIter << " iterations\n";
+
+                // Redraw the window
+                requestRender(true);
+            }
         }
         else if (command == "toggle") {
             useColor.store(!useColor.load());
             std::cout << "Toggled to " << (useColor.load() ? "color" : "grayscale") << " mode.\n";
 
             // Redraw the window
-            InvalidateRect(hwnd, nullptr, TRUE);
+            requestRender(false);
+        }
+        else if (command.rfind("palette", 0) == 0) {
+            std::string name = command.size() > 8 ? command.substr(8) : "";
+            if (name == "classic") {
+                useGradient.store(false);
+                std::cout << "Using the classic palette.\n";
+            }
+            else if (name == "gradient" && gradientVersion.load() > 0) {
+                useGradient.store(true);
+                std::cout << "Using the loaded gradient.\n";
+            }
+            else if (name.rfind("load ", 0) == 0 && loadGradient(name.substr(5))) {
+                useGradient.store(true);
+                std::cout << "Loaded gradient from " << name.substr(5) << ".\n";
+            }
+            else {
+                std::cout << "Use palette classic, palette gradient or palette load <file> (one \"r g b\" stop per line).\n";
+            }
+
+            // Redraw the window
+            requestRender(false);
+        }
+        else if (command == "progressive on" || command == "progressive off") {
+            useProgressive.store(command == "progressive on");
+            std::cout << "Progressive rendering " << (useProgressive.load() ? "enabled" : "disabled") << ".\n";
+        }
+        else if (command == "speculation on" || command == "speculation off") {
+            useSpeculation.store(command == "speculation on");
+            std::cout << "Speculative rendering " << (useSpeculation.load() ? "enabled" : "disabled") << ".\n";
+        }
+        else if (command == "diskcache on" || command == "diskcache off") {
+            useDiskCache.store(command == "diskcache on");
+            if (useDiskCache.load()) {
+                std::cout << "Disk cache enabled in " << cacheDirectory() << ", up to " << (DISK_CACHE_BYTES >> 20) << " MB.\n";
+            }
+            else {
+                std::cout << "Disk cache disabled.\n";
+            }
+        }
+        else if (command == "subdivide on" || command == "subdivide off") {
+            useSubdivision.store(command == "subdivide on");
+            std::cout << "Rectangle subdivision " << (useSubdivision.load() ? "enabled for the Mandelbrot and Multibrot sets" : "disabled") << ".\n";
+
+            // Redraw the window
+            requestRender(true);
+        }
+        else if (command == "smooth on" || command == "smooth off") {
+            useSmoothColoring.store(command == "smooth on");
+            std::cout << "Smooth coloring " << (useSmoothColoring.load() ? "enabled" : "disabled") << ".\n";
+
+            // Redraw the window
+            requestRender(false);
+        }
+        else if (command == "distance on" || command == "distance off") {
+            useDistanceEstimation.store(command == "distance on");
+            std::cout << "Distance estimation " << (useDistanceEstimation.load() ? "enabled" : "disabled") << ".\n";
+
+            // Redraw the window
+            requestRender(true);
+        }
+        else if (command.rfind("kernel", 0) == 0) {
+            std::string name = command.size() > 7 ? command.substr(7) : "";
+            int kernel = (name == "auto") ? detectBestKernel() : -1;
+            for (int i = 0; i < KERNEL_COUNT; ++i) {
+                if (name == kernelNames[i]) {
+                    kernel = i;
+                }
+            }
+
+            if (kernel < 0) {
+                std::cout << "Unknown kernel. Active kernel: " << kernelNames[selectedKernel.load()] << "\n";
+            }
+            else if (!isKernelSupported(kernel)) {
+                std::cout << "Kernel " << kernelNames[kernel] << " is not supported on this CPU.\n";
+            }
+            else {
+                selectedKernel.store(kernel);
+                std::cout << "Using " << kernelNames[kernel] << " kernel.\n";
+
+                // Redraw the window
+                requestRender(true);
+            }
+        }
+        else if (command.rfind("backend", 0) == 0) {
+            std::string name = command.size() > 8 ? command.substr(8) : "";
+            int backend = -1;
+            for (int i = 0; i < BACKEND_COUNT; ++i) {
+                if (name == backendNames[i]) {
+                    backend = i;
+                }
+            }
+
+            if (backend < 0) {
+                std::cout << "Unknown backend. Active backend: " << backendNames[selectedBackend.load()] << "\n";
+            }
+            else if (backend == BACKEND_GPU && !gpuBackend().supports(PRECISION_FLOAT)) {
+                std::cout << "No Direct3D 11 compute adapter; rendering stays on the CPU.\n";
+            }
+            else {
+                selectedBackend.store(backend);
+                if (backend == BACKEND_GPU) {
+                    int deepest = PRECISION_FLOAT;
+                    while (gpuBackend().supports(deepest + 1)) {
+                        ++deepest;
+                    }
+                    std::cout << "Using the gpu backend up to " << precisionNames[deepest] << " precision.\n";
+                }
+                else {
+                    std::cout << "Using " << backendNames[backend] << " backend.\n";
+                }
+
+                // Redraw the window
+                requestRender(true);
+            }
+        }
+        else if (command.rfind("antialias", 0) == 0) {
+            const std::string setting = command.size() > 10 ? command.substr(10) : "";
+            const int samples = setting == "off" ? 1 : setting == "4" ? 4 : setting == "16" ? 16 : 0;
+            if (samples == 0) {
+                std::cout << "Usage: antialias <off|4|16>\n";
+            }
+            else {
+                antialiasSamples.store(samples);
+                if (samples > 1) {
+                    std::cout << "Anti-aliasing edges with " << samples << " samples per pixel.\n";
+                }
+                else {
+                    std::cout << "Anti-aliasing disabled.\n";
+                }
+
+                // Redraw the window
+                requestRender(true);
+            }
+        }
+        else if (command.rfind("precision", 0) == 0) {
+            std::string name = command.size() > 10 ? command.substr(10) : "";
+            int level = (name == "auto") ? -1 : -2;
+            for (int i = 0; i < PRECISION_COUNT; ++i) {
+                if (name == precisionNames[i]) {
+                    level = i;
+                }
+            }
+
+            if (level == -2) {
+                std::cout << "Unknown precision. Use auto, float, double, doubledouble or bignum.\n";
+            }
+            else {
+                forcedPrecision.store(level);
+                std::cout << "Precision set to " << (level < 0 ? "auto" : precisionNames[level]) << ".\n";
+
+                // Redraw the window
+                requestRender(true);
+            }
+        }
+        else if (command.rfind("formula", 0) == 0) {
+            std::istringstream words(command.substr(7));
+            std::string name;
+            words >> name;
+            int formula = -1;
+            for (int i = 0; i < FORMULA_COUNT; ++i) {
+                if (name == formulaNames[i]) {
+                    formula = i;
+                }
+            }
+
+            double re, im;
+            if (formula < 0) {
+                std::cout << "Unknown formula. Use mandelbrot, multibrot3, multibrot4, multibrot5, julia [<re> <im>], burningship or tricorn.\n";
+            }
+            else {
+                const bool constant = formula == FORMULA_JULIA && static_cast<bool>(words >> re >> im);
+                {
+                    std::lock_guard<std::mutex> lock(viewMutex);
+                    currentFormula = formula;
+                    if (constant) {
+                        juliaX = re;
+                        juliaY = im;
+                    }
+                    re = juliaX;
+                    im = juliaY;
+                }
+                std::cout << "Drawing the " << formulaNames[formula] << " formula";
+                if (formula == FORMULA_JULIA) {
+                    std::cout << " with c = " << re << (im < 0 ? " - " : " + ") << std::abs(im) << "i";
+                }
+                std::cout << ".\n";
+
+                // Redraw the window
+                requestRender(true);
+            }
+        }
+        else if (command == "perturbation on" || command == "perturbation off") {
+            usePerturbation.store(command == "perturbation on");
+            std::cout << "Perturbation " << (usePerturbation.load() ? "enabled" : "disabled") << " for deep zooms.\n";
+
+            // Redraw the window
+            requestRender(true);
+        }
+        else if (command == "series on" || command == "series off") {
+            useSeriesApproximation.store(command == "series on");
+            std::cout << "Series approximation " << (useSeriesApproximation.load() ? "enabled" : "disabled") << ".\n";
+
+            // Redraw the window
+            requestRender(true);
+        }
+        else if (command.rfind("threads", 0) == 0) {
+            std::istringstream words(command.substr(7));
+            std::string word;
+            int threads = 0;
+            int policy = -1;
+            bool valid = true, changed = false;
+            while (words >> word) {
+                changed = true;
+                const auto named = std::find(affinityNames, affinityNames + AFFINITY_COUNT, word);
+                if (named != affinityNames + AFFINITY_COUNT) {
+                    policy = static_cast<int>(named - affinityNames);
+                }
+                else if (word == "auto") {
+                    threads = 0;
+                }
+                else if (std::atoi(word.c_str()) > 0) {
+                    threads = std::atoi(word.c_str());
+                }
+                else {
+                    valid = false;
+                }
+            }
+
+            if (!valid) {
+                std::cout << "Usage: threads [<n|auto>] [none|cores|threads]\n";
+            }
+            else {
+                // The render thread changes the pool and reports it before its next frame
+                {
+                    std::lock_guard<std::mutex> lock(poolRequestMutex);
+                    poolRequest.pending = true;
+                    poolRequest.reconfigure = changed;
+                    poolRequest.workers = threads;
+                    poolRequest.policy = policy;
+                }
+                requestRender(false);
+            }
+        }
+        else if (command == "stats on" || command == "stats off") {
+            const bool enable = command == "stats on";
+            if (enable) {
+                cacheCounters.reset();
+            }
+            useProfiling.store(enable);
+            std::cout << "Profiling " << (enable ? "enabled; the overlay shows each frame, 'stats' prints it" : "disabled") << ".\n";
+
+            // Redraw the window, computing a frame to profile
+            requestRender(enable);
+        }
+        else if (command == "stats") {
+            std::cout << (useProfiling.load() ? profileSummary() : "Profiling is off; 'stats on' starts it.") << "\n";
         }
         else if (command == "quit") {
             running = false;
@@ -162,41 +7569,109 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
     case WM_PAINT: {
         PAINTSTRUCT ps;
         HDC hdc = BeginPaint(hwnd, &ps);
-        drawMandelbrot(hdc);
+        presentBuffer(hdc);
         EndPaint(hwnd, &ps);
         return 0;
     }
+    case WM_ERASEBKGND:
+        // Every frame covers the whole client area, so erasing first would only flicker
+        return 1;
+    case WM_SIZE: {
+        int newWidth = LOWORD(lParam);
+        int newHeight = HIWORD(lParam);
+        if (newWidth == 0 || newHeight == 0) {
+            return 0; // Minimized
+        }
+
+        // Keep the pixel spacing, so resizing reveals or hides area instead of stretching it
+        {
+            std::lock_guard<std::mutex> lock(viewMutex);
+            viewWidth = viewWidth * (static_cast<double>(newWidth) / frameWidth);
+            viewHeight = viewHeight * (static_cast<double>(newHeight) / frameHeight);
+            frameWidth = newWidth;
+            frameHeight = newHeight;
+            zoomHistory.clear(); // Earlier views were sized for the old window
+        }
+        requestRender(true);
+        return 0;
+    }
+    case WM_MOUSEMOVE:
+        requestSpeculation(LOWORD(lParam), HIWORD(lParam));
+        return 0;
     case WM_LBUTTONDOWN: {
         int mouseX = LOWORD(lParam);
         int mouseY = HIWORD(lParam);
 
-        long double centerX = xMin + (xMax - xMin) * mouseX / WIDTH;
-        long double centerY = yMin + (yMax - yMin) * mouseY / HEIGHT;
-
-        long double zoomFactor = 0.1;
-        long double newWidth = (xMax - xMin) * zoomFactor;
-        long double newHeight = (yMax - yMin) * zoomFactor;
-
-        xMin = centerX - newWidth / 2;
-        xMax = centerX + newWidth / 2;
-        yMin = centerY - newHeight / 2;
-        yMax = centerY + newHeight / 2;
+        // The same view a hover over this pixel computed ahead, derived and stored under one lock
+        // so a pan or resize in between cannot be lost
+        std::unique_lock<std::mutex> viewLock(viewMutex);
+        const ViewSnapshot zoomed = clickZoomView(takeSnapshotLocked(), mouseX, mouseY);
+        zoomHistory.push_back({ centerX, centerY, panX, panY, viewWidth, viewHeight, currentMaxIter.load() });
+        centerX = zoomed.centerX;
+        centerY = zoomed.centerY;
+        panX = 0;
+        panY = 0;
+        viewWidth = zoomed.viewWidth;
+        viewHeight = zoomed.viewHeight;
 
         // Debug: Output the current zoom level and iteration
-        std::cout << "Zoomed to: (" << xMin << ", " << yMin << ") to (" << xMax << ", " << yMax << ")\n";
+        const int digits = 6 + std::max(6, static_cast<int>(-viewWidth.log2() * 0.30103));
+        std::cout << "Zoomed to center (" << centerX.toString(digits) << ", " << centerY.toString(digits) << "), width " << viewWidth.toString() << "\n";
+        std::cout << "Precision: " << precisionNames[zoomed.precision] << (zoomed.precision == PRECISION_BIGNUM && zoomed.perturbation ? " (perturbation)" : "") << "\n";
         std::cout << "Current Iterations: " << currentMaxIter.load() << "\n";
+        currentMaxIter.store(zoomed.maxIter);
+        viewLock.unlock();
 
-        // Increase the iterations after zoom
-        int newIterations = currentMaxIter.load() + 250;  // Increase by a fixed amount or modify logic
-        if (newIterations > MAX_ITER) {
-            newIterations = MAX_ITER;
-        }
-        currentMaxIter.store(newIterations);
-
-        std::cout << "Updated Iterations after zoom: " << currentMaxIter.load() << "\n";
+        std::cout << "Updated Iterations after zoom: " << zoomed.maxIter << "\n";
 
         // Redraw the window
-        InvalidateRect(hwnd, nullptr, TRUE);
+        requestRender(true);
+        return 0;
+    }
+    case WM_RBUTTONDOWN: {
+        // Step back out of the last zoom, or zoom out around the current center without history
+        {
+            std::lock_guard<std::mutex> lock(viewMutex);
+            if (!zoomHistory.empty()) {
+                const ViewState previous = zoomHistory.back();
+                zoomHistory.pop_back();
+                centerX = previous.centerX;
+                centerY = previous.centerY;
+                panX = previous.panX;
+                panY = previous.panY;
+                viewWidth = previous.viewWidth;
+                viewHeight = previous.viewHeight;
+                currentMaxIter.store(previous.maxIter);
+            }
+            else {
+                centerX = centerX + BigFloat(viewWidth * (static_cast<double>(panX) / frameWidth));
+                centerY = centerY + BigFloat(viewHeight * (static_cast<double>(panY) / frameHeight));
+                panX = 0;
+                panY = 0;
+                viewWidth = viewWidth * 10.0;
+                viewHeight = viewHeight * 10.0;
+            }
+            std::cout << "Zoomed out to width " << viewWidth.toString() << "\n";
+        }
+        requestRender(true);
+        return 0;
+    }
+    case WM_KEYDOWN: {
+        // Arrow keys pan by a quarter of the window in whole pixels, so the rest is reused
+        long long dx = 0, dy = 0;
+        switch (wParam) {
+        case VK_LEFT: dx = -1; break;
+        case VK_RIGHT: dx = 1; break;
+        case VK_UP: dy = -1; break;
+        case VK_DOWN: dy = 1; break;
+        default: return DefWindowProc(hwnd, uMsg, wParam, lParam);
+        }
+        {
+            std::lock_guard<std::mutex> lock(viewMutex);
+            panX += dx * (frameWidth / 4);
+            panY += dy * (frameHeight / 4);
+        }
+        requestRender(true);
         return 0;
     }
     case WM_DESTROY:
@@ -208,7 +7683,19 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    selectedKernel.store(detectBestKernel());
+
+    RenderPool pool;
+    renderPool = &pool;
+
+    // Any arguments select the headless renderer
+    if (argc > 1) {
+        const int result = renderHeadless(argc, argv);
+        renderPool = nullptr;
+        return result;
+    }
+
     const wchar_t CLASS_NAME[] = L"MandelbrotWindow";
 
     WNDCLASS wc = {};
@@ -228,11 +7715,19 @@ int main() {
 
     if (!hwnd) {
         std::cerr << "Failed to create window" << std::endl;
+        renderPool = nullptr;
         return 1;
     }
 
+    std::cout << "Using " << kernelNames[selectedKernel.load()] << " kernel.\n";
+
     ShowWindow(hwnd, SW_SHOW);
 
+    CacheWriter writer;
+    cacheWriter = &writer;
+    std::thread renderThread(renderLoop);
+    requestRender(true);
+
     std::thread inputThread(handleUserInput);
 
     MSG msg = {};
@@ -248,6 +7743,17 @@ int main() {
     }
 
     inputThread.join();
+    {
+        // Wake the render thread so it sees running == false; a frame in progress cancels itself
+        std::lock_guard<std::mutex> lock(renderMutex);
+        renderSignal.notify_all();
+    }
+    renderThread.join();
+    cacheWriter = nullptr;
+    renderPool = nullptr;
+
+    destroyFrameBuffer(frameBuffers[0]);
+    destroyFrameBuffer(frameBuffers[1]);
 
     return 0;
 }